@@ -0,0 +1,171 @@
+#ifndef JSONISH_BENCH_H
+#define JSONISH_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+/*
+  Minimal timing helpers shared by the benchmarks.
+  Every benchmark takes an optional size argument in MB (default 16).
+*/
+namespace bench
+{
+
+inline std::size_t size_arg(int argc, char* argv[], std::size_t default_mb = 16)
+{
+    std::size_t mb = default_mb;
+    if (argc > 1)
+        mb = std::strtoul(argv[1], nullptr, 10);
+    return std::max<std::size_t>(mb, 1) * 1024 * 1024;
+}
+
+//keeps the optimizer from discarding results
+template <typename T>
+inline void keep(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+/*
+  Run f until at least min_seconds have passed and return the best seconds per call.
+*/
+template <typename F>
+inline double best_seconds(F f, double min_seconds = 0.5)
+{
+    using clock = std::chrono::steady_clock;
+
+    double best = 1e30;
+    double total = 0;
+    int runs = 0;
+    while (total < min_seconds || runs < 3)
+    {
+        auto start = clock::now();
+        f();
+        std::chrono::duration<double> elapsed = clock::now() - start;
+        best = std::min(best, elapsed.count());
+        total += elapsed.count();
+        runs++;
+    }
+    return best;
+}
+
+inline void report(const char* name, double seconds, std::size_t bytes)
+{
+    std::printf("%-32s %10.1f MB/s\n", name, bytes / seconds / (1024 * 1024));
+}
+
+inline void report_rate(const char* name, double seconds, std::size_t items, const char* unit)
+{
+    std::printf("%-32s %10.2f M%s/s\n", name, items / seconds / 1e6, unit);
+}
+
+/*
+  A top level array of strings with lengths uniformly drawn from [min_length, max_length],
+  about bytes long in total. With escape_every, about one character in
+  escape_every is an escape sequence.
+*/
+inline std::string string_array(std::size_t bytes, std::size_t min_length, std::size_t max_length,
+                                unsigned int seed = 42, std::size_t escape_every = 0)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/ .:-_";
+    static const char* const escapes[] = { "\\n", "\\t", "\\\"", "\\\\", "\\u00e9" };
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<std::size_t> length(min_length, max_length);
+    std::uniform_int_distribution<std::size_t> letter(0, sizeof(alphabet) - 2);
+    std::uniform_int_distribution<std::size_t> escape(0, escape_every ? escape_every - 1 : 0);
+    std::uniform_int_distribution<std::size_t> which(0, sizeof(escapes) / sizeof(escapes[0]) - 1);
+
+    std::string result = "[";
+    while (result.size() < bytes)
+    {
+        if (result.size() > 1)
+            result += ",\n";
+        result += '"';
+        for (std::size_t n = length(rng); n > 0; --n)
+        {
+            if (escape_every && escape(rng) == 0)
+                result += escapes[which(rng)];
+            else
+                result += alphabet[letter(rng)];
+        }
+        result += '"';
+    }
+    result += "]";
+    return result;
+}
+
+//one small record, an object with fields_per_object members of mixed types
+inline void append_object(std::string& result, std::mt19937& rng, unsigned int id,
+                          unsigned int fields_per_object)
+{
+    std::uniform_int_distribution<int> number(0, 1000000);
+    char buf[64];
+
+    result += "{\"id\":" + std::to_string(id);
+    for (unsigned int f = 1; f < fields_per_object; ++f)
+    {
+        std::snprintf(buf, sizeof(buf), ",\"field_%u\":", f);
+        result += buf;
+        switch (f % 5)
+        {
+        case 0: result += std::to_string(number(rng)); break;
+        case 1: result += "\"value " + std::to_string(number(rng)) + "\""; break;
+        case 2: result += (number(rng) & 1) ? "true" : "null"; break;
+        case 3: result += "[1,2,3]"; break;
+        case 4: result += "{\"x\":1,\"y\":2}"; break;
+        }
+    }
+    result += "}";
+}
+
+/*
+  A top level array of small records, about bytes long, each an object with
+  fields_per_object members of mixed types including a nested object and array.
+*/
+inline std::string object_array(std::size_t bytes, unsigned int fields_per_object = 8,
+                                unsigned int seed = 42)
+{
+    std::mt19937 rng(seed);
+
+    std::string result = "[";
+    unsigned int id = 0;
+    while (result.size() < bytes)
+    {
+        if (result.size() > 1)
+            result += ",";
+        append_object(result, rng, id++, fields_per_object);
+    }
+    result += "]";
+    return result;
+}
+
+//the same records as newline delimited JSON, one per line
+inline std::string object_lines(std::size_t bytes, unsigned int fields_per_object = 8,
+                                unsigned int seed = 42)
+{
+    std::mt19937 rng(seed);
+
+    std::string result;
+    unsigned int id = 0;
+    while (result.size() < bytes)
+    {
+        append_object(result, rng, id++, fields_per_object);
+        result += "\n";
+    }
+    return result;
+}
+
+} //bench
+
+#endif //JSONISH_BENCH_H
@@ -0,0 +1,47 @@
+#include <iostream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Parse and tear down many small objects, once into heap allocated Values
+  and once into an arena backed Document.
+*/
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv);
+    std::string text = bench::object_array(bytes);
+    std::cout << "small objects, " << text.size() / (1024 * 1024) << " MB\n";
+
+    auto on_error = [](const Error& e) { std::cerr << e.message << '\n'; };
+
+    double seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            Value v = parser.parse(on_error);
+            bench::keep(v);
+        });
+    bench::report("  Value parse + destroy", seconds, text.size());
+
+    seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            Document document;
+            parser.parse(document, on_error);
+            bench::keep(document);
+        });
+    bench::report("  Document parse + destroy", seconds, text.size());
+
+    Document reused;
+    seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            parser.parse(reused, on_error);
+            bench::keep(reused);
+        });
+    bench::report("  Document reused", seconds, text.size());
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Per message latency on a corpus where about 5% of the messages are malformed.
+  Compares the status code parse against the templated and std::function
+  callback parses and against a callback that throws, which is what the parser itself used to do for every
+  error.
+*/
+
+struct message
+{
+    std::string text;
+    bool valid;
+};
+
+static std::vector<message> make_corpus(std::size_t count)
+{
+    std::mt19937 rng(7);
+    std::vector<message> corpus;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string text = bench::object_array(1, 8, static_cast<unsigned int>(i));
+        bool valid = rng() % 100 >= 5;
+        if (!valid)
+        {
+            //break it somewhere in the second half, like a truncated or corrupted message
+            std::size_t pos = text.size() / 2 + rng() % (text.size() / 2);
+            switch (rng() % 3)
+            {
+            case 0: text.resize(pos); break;
+            case 1: text[pos] = ':'; break;
+            case 2: text.insert(pos, "tru"); break;
+            }
+        }
+        corpus.push_back(message{text, valid});
+    }
+    return corpus;
+}
+
+static void percentiles(const char* name, std::vector<double>& ns)
+{
+    if (ns.empty())
+        return;
+
+    std::sort(ns.begin(), ns.end());
+    auto at = [&ns](double p) { return ns[std::min(ns.size() - 1, static_cast<std::size_t>(p * ns.size()))]; };
+    std::printf("    %-10s p50 %8.0f ns   p99 %8.0f ns   p99.9 %8.0f ns\n",
+                name, at(0.50), at(0.99), at(0.999));
+}
+
+template <typename Parse>
+static void run(const char* name, const std::vector<message>& corpus, Parse parse)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::vector<double> valid_ns, invalid_ns;
+    std::size_t failures = 0;
+
+    //one warm up pass and one measured pass
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        valid_ns.clear();
+        invalid_ns.clear();
+        failures = 0;
+        for (const auto& m : corpus)
+        {
+            auto start = clock::now();
+            bool ok = parse(m.text);
+            std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+
+            (m.valid ? valid_ns : invalid_ns).push_back(elapsed.count());
+            failures += !ok;
+        }
+    }
+
+    std::cout << "  " << name << " (" << failures << " errors)\n";
+    std::vector<double> all(valid_ns);
+    all.insert(all.end(), invalid_ns.begin(), invalid_ns.end());
+    percentiles("all", all);
+    percentiles("valid", valid_ns);
+    percentiles("invalid", invalid_ns);
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const std::size_t count = bench::size_arg(argc, argv, 1) / 16;
+    auto corpus = make_corpus(count);
+    std::cout << corpus.size() << " messages\n";
+
+    run("status code", corpus, [](const std::string& text)
+        {
+            Parser parser{text};
+            Value v;
+            Error e;
+            bool ok = parser.parse(v, e);
+            bench::keep(v);
+            return ok;
+        });
+
+    run("callback", corpus, [](const std::string& text)
+        {
+            Parser parser{text};
+            bool ok = true;
+            Value v = parser.parse([&ok](const Error&) { ok = false; });
+            bench::keep(v);
+            return ok;
+        });
+
+    run("std::function callback", corpus, [](const std::string& text)
+        {
+            Parser parser{text};
+            bool ok = true;
+            std::function<void(const Error&)> on_error = [&ok](const Error&) { ok = false; };
+            Value v = parser.parse(on_error);
+            bench::keep(v);
+            return ok;
+        });
+
+    run("throwing callback", corpus, [](const std::string& text)
+        {
+            try
+            {
+                Parser parser{text};
+                Value v = parser.parse([](const Error& e) { throw e; });
+                bench::keep(v);
+                return true;
+            }
+            catch (const Error&)
+            {
+                return false;
+            }
+        });
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <cstring>
+#include <iostream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Pull two fields out of every record of newline delimited JSON, once by
+  parsing each record into a Document and looking the fields up, and once
+  with a Query that skips everything else.
+*/
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv);
+    const std::string text = bench::object_lines(bytes, 24);
+    const auto records = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    std::cout << "extract /id and /field_4/x, " << records << " records, "
+              << text.size() / (1024 * 1024) << " MB\n";
+
+    long long sum = 0;
+    double seconds = bench::best_seconds([&]()
+        {
+            NdjsonParser ndjson{text};
+            Document document;
+            Error error;
+            while (!ndjson.done())
+            {
+                if (!ndjson.next(document, error))
+                    continue;
+
+                const auto& record = document.root().get<e_JsonType::Object>();
+                sum += record["id"].get<e_JsonType::Integer>();
+                sum += record["field_4"].get<e_JsonType::Object>()["x"].get<e_JsonType::Integer>();
+            }
+        });
+    bench::report_rate("  NdjsonParser + lookups", seconds, records, "records");
+
+    seconds = bench::best_seconds([&]()
+        {
+            Query query{"/id", "/field_4/x"};
+            Error error;
+            auto add = [&sum](std::size_t, const Value& value) { sum += value.get<e_JsonType::Integer>(); };
+            for (auto pos = text.data(), end = pos + text.size(); pos < end; )
+            {
+                auto line_end = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+                query.run(pos, line_end, add, error);
+                pos = line_end + 1;
+            }
+        });
+    bench::report_rate("  Query", seconds, records, "records");
+
+    bench::keep(sum);
+    return 0;
+}
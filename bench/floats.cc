@@ -0,0 +1,114 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+#include "../jsonish_number.hpp"
+
+/*
+  Floating point decoding on float dense input: GeoJSON style coordinate
+  pairs and metrics with exponents. The number tokens are decoded with
+  strtod, as the Reader used to, and with decode_float, then the whole
+  document is parsed into a Document.
+*/
+
+static std::string coordinates(std::size_t bytes)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> longitude(-180, 180), latitude(-90, 90);
+    char buf[64];
+
+    std::string result = "[";
+    while (result.size() < bytes)
+    {
+        if (result.size() > 1)
+            result += ",";
+        std::snprintf(buf, sizeof(buf), "[%.7f,%.7f]", longitude(rng), latitude(rng));
+        result += buf;
+    }
+    result += "]";
+    return result;
+}
+
+static std::string metrics(std::size_t bytes)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> mantissa(1, 10);
+    std::uniform_int_distribution<int> exponent(-12, 12);
+    char buf[64];
+
+    std::string result = "[";
+    while (result.size() < bytes)
+    {
+        if (result.size() > 1)
+            result += ",";
+        std::snprintf(buf, sizeof(buf), "%.15ge%d", mantissa(rng), exponent(rng));
+        result += buf;
+    }
+    result += "]";
+    return result;
+}
+
+static void run(const char* name, const std::string& text)
+{
+    using namespace jsonish;
+
+    std::vector<String> tokens;
+    for (std::size_t pos = 0; pos < text.size(); )
+    {
+        pos = text.find_first_of("-0123456789", pos);
+        if (pos == std::string::npos)
+            break;
+        auto end = text.find_first_of(",]", pos);
+        tokens.emplace_back(text.data() + pos, text.data() + end);
+        pos = end;
+    }
+    std::cout << name << ", " << tokens.size() << " values, " << text.size() / (1024 * 1024) << " MB\n";
+
+    double sum = 0;
+    double seconds = bench::best_seconds([&]()
+        {
+            for (const auto& token : tokens)
+            {
+                char* endptr = nullptr;
+                errno = 0;
+                auto value = strtod(token.begin(), &endptr);
+                if (endptr == token.end() && errno != ERANGE)
+                    sum += value;
+            }
+        });
+    bench::report_rate("  strtod", seconds, tokens.size(), "values");
+
+    seconds = bench::best_seconds([&]()
+        {
+            for (const auto& token : tokens)
+            {
+                double value;
+                if (impl::decode_float(token.begin(), token.end(), value) == impl::e_NumberStatus::Ok)
+                    sum += value;
+            }
+        });
+    bench::report_rate("  decode_float", seconds, tokens.size(), "values");
+
+    Document document;
+    Error error;
+    seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            parser.parse(document, error);
+            bench::keep(document);
+        });
+    bench::report("  Parser into Document", seconds, text.size());
+
+    bench::keep(sum);
+}
+
+int main(int argc, char* argv[])
+{
+    const auto bytes = bench::size_arg(argc, argv);
+    run("coordinates", coordinates(bytes));
+    run("metrics", metrics(bytes));
+    return 0;
+}
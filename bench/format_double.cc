@@ -0,0 +1,72 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Floating point formatting: the same doubles written with snprintf("%.17g"),
+  the shortest correct form printf offers, and with format_double, then a
+  whole array of them through jsonish::write.
+*/
+
+static void run(const char* name, const std::vector<double>& values)
+{
+    using namespace jsonish;
+
+    std::cout << name << ", " << values.size() << " values\n";
+
+    char buf[32];
+    std::size_t length = 0;
+    double seconds = bench::best_seconds([&]()
+        {
+            for (auto d : values)
+                length += std::snprintf(buf, sizeof(buf), "%.17g", d);
+        });
+    bench::report_rate("  snprintf %.17g", seconds, values.size(), "values");
+
+    seconds = bench::best_seconds([&]()
+        {
+            for (auto d : values)
+                length += impl::format_double(buf, d) - buf;
+        });
+    bench::report_rate("  format_double", seconds, values.size(), "values");
+
+    Array array;
+    for (auto d : values)
+        array.emplace_back(d);
+    const Value value(std::move(array));
+    std::size_t bytes = 0;
+    seconds = bench::best_seconds([&]()
+        {
+            std::ostringstream out;
+            write(out, value);
+            bytes = out.tellp();
+        });
+    bench::report("  write", seconds, bytes);
+
+    bench::keep(length);
+}
+
+int main(int argc, char* argv[])
+{
+    const auto count = bench::size_arg(argc, argv) / 16;
+    std::mt19937 rng(42);
+
+    //coordinates with a handful of significant digits
+    std::uniform_real_distribution<double> longitude(-180, 180);
+    std::vector<double> short_values;
+    for (std::size_t i = 0; i < count; ++i)
+        short_values.push_back(std::round(longitude(rng) * 1e7) / 1e7);
+    run("coordinates", short_values);
+
+    //results of arithmetic, which need all 17 digits
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<double> long_values;
+    for (std::size_t i = 0; i < count; ++i)
+        long_values.push_back(unit(rng) * 1000);
+    run("computed", long_values);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+#include "../jsonish_number.hpp"
+
+/*
+  Integer decoding. The integer tokens of an array of mixed length integers
+  are decoded with strtoll, as the Reader used to, and with decode_integer,
+  then the whole array is parsed into a Document.
+*/
+
+static std::string integer_array(std::size_t bytes)
+{
+    std::mt19937_64 rng(42);
+    std::string result = "[";
+    while (result.size() < bytes)
+    {
+        if (result.size() > 1)
+            result += ",";
+
+        //lengths from 1 to 19 digits, about as often as each other
+        const auto digits = 1 + rng() % 19;
+        auto value = static_cast<long long>(rng() % 1000000000000000000ULL);
+        for (auto d = digits; d < 19; ++d)
+            value /= 10;
+        result += std::to_string((rng() & 1) ? -value : value);
+    }
+    result += "]";
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv);
+    const std::string text = integer_array(bytes);
+
+    std::vector<String> tokens;
+    for (std::size_t pos = 1; pos < text.size(); )
+    {
+        auto end = text.find_first_of(",]", pos);
+        tokens.emplace_back(text.data() + pos, text.data() + end);
+        pos = end + 1;
+    }
+    std::cout << "integers, " << tokens.size() << " values, " << text.size() / (1024 * 1024) << " MB\n";
+
+    long long sum = 0;
+    double seconds = bench::best_seconds([&]()
+        {
+            for (const auto& token : tokens)
+            {
+                char* endptr = nullptr;
+                errno = 0;
+                auto value = strtoll(token.begin(), &endptr, 10);
+                if (endptr == token.end() && errno != ERANGE)
+                    sum += value;
+            }
+        });
+    bench::report_rate("  strtoll", seconds, tokens.size(), "values");
+
+    seconds = bench::best_seconds([&]()
+        {
+            for (const auto& token : tokens)
+            {
+                long long value;
+                if (impl::decode_integer(token.begin(), token.end(), value) == impl::e_NumberStatus::Ok)
+                    sum += value;
+            }
+        });
+    bench::report_rate("  decode_integer", seconds, tokens.size(), "values");
+
+    Document document;
+    Error error;
+    seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            parser.parse(document, error);
+            bench::keep(document);
+        });
+    bench::report("  Parser into Document", seconds, text.size());
+
+    bench::keep(sum);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Open a large document and read three fields from it, once after a full
+  Document parse and once after a lazy one that leaves the bulk of the
+  input, a large array of records, unparsed.
+*/
+
+static long long read_fields(const jsonish::Value& root)
+{
+    using namespace jsonish;
+
+    const auto& object = root.get<e_JsonType::Object>();
+    const auto& meta = object["meta"].get<e_JsonType::Object>();
+    return object["count"].get<e_JsonType::Integer>() +
+           meta["version"].get<e_JsonType::Integer>() +
+           static_cast<long long>(object["name"].get<e_JsonType::String>().size());
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv, 64);
+    const std::string text = "{\"name\":\"records\",\"meta\":{\"version\":3,\"source\":\"bench\"},"
+                             "\"records\":" + bench::object_array(bytes) + ",\"count\":1}";
+    std::cout << "read 3 fields of a " << bytes / (1024 * 1024) << " MB document\n";
+
+    Error error;
+    Document document;
+    long long sum = 0;
+
+    double seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            if (!parser.parse(document, error))
+                std::cerr << error.message << '\n';
+            sum += read_fields(document.root());
+        });
+    bench::report("  Document", seconds, text.size());
+
+    seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            if (!parser.parse_lazy(document, error))
+                std::cerr << error.message << '\n';
+            sum += read_fields(document.root());
+        });
+    bench::report("  parse_lazy", seconds, text.size());
+
+    bench::keep(sum);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Records per second on newline delimited JSON where about 1% of the lines
+  are malformed. Compares splitting the lines by hand with a fresh Parser and
+  Value per line against NdjsonParser reusing one Document.
+*/
+
+static std::string make_input(std::size_t bytes)
+{
+    std::string text = bench::object_lines(bytes);
+
+    //truncate every 100th record
+    std::size_t line = 0;
+    for (std::size_t pos = text.find('\n'); pos != std::string::npos; pos = text.find('\n', pos + 1))
+    {
+        if (++line % 100 == 0)
+            text[pos - 1] = ' ';
+    }
+    return text;
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv);
+    const std::string text = make_input(bytes);
+    const auto records = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    std::cout << "ndjson, " << records << " records, " << text.size() / (1024 * 1024) << " MB\n";
+
+    std::size_t errors = 0;
+    double seconds = bench::best_seconds([&]()
+        {
+            errors = 0;
+            std::size_t start = 0;
+            while (start < text.size())
+            {
+                auto end = text.find('\n', start);
+                std::string line = text.substr(start, end - start);
+                start = end + 1;
+
+                Parser parser{line};
+                Value value;
+                Error error;
+                if (!parser.parse(value, error))
+                    errors++;
+                bench::keep(value);
+            }
+        });
+    bench::report_rate("  Parser + Value per line", seconds, records, "records");
+
+    seconds = bench::best_seconds([&]()
+        {
+            errors = 0;
+            NdjsonParser ndjson{text};
+            Document document;
+            Error error;
+            while (!ndjson.done())
+            {
+                if (!ndjson.next(document, error))
+                    errors++;
+                bench::keep(document);
+            }
+        });
+    bench::report_rate("  NdjsonParser, one Document", seconds, records, "records");
+    bench::report("", seconds, text.size());
+
+    std::cout << "  " << errors << " malformed records\n";
+    return 0;
+}
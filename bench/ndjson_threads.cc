@@ -0,0 +1,50 @@
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Scaling of parse_ndjson from 1 to 32 threads, delivering the records in
+  order and unordered. The callbacks only count, so this measures parsing.
+  Default input is 64 MB.
+*/
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv, 64);
+    const std::string text = bench::object_lines(bytes);
+    const auto records = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    std::cout << "ndjson, " << records << " records, " << text.size() / (1024 * 1024) << " MB, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+
+    const char* start = text.data();
+    const char* end = text.data() + text.size();
+
+    for (unsigned int threads : {1u, 2u, 4u, 8u, 16u, 32u})
+    {
+        for (auto order : {e_Order::InOrder, e_Order::Unordered})
+        {
+            std::atomic<std::size_t> count(0);
+            double seconds = bench::best_seconds([&]()
+                {
+                    count = 0;
+                    parse_ndjson(start, end, threads, order,
+                                 [&count](std::size_t, Value&) { count.fetch_add(1, std::memory_order_relaxed); },
+                                 [](std::size_t line, const Error& e) { std::cerr << line << ": " << e.message << '\n'; });
+                });
+
+            if (count != records)
+                std::cerr << "parsed " << count << " of " << records << " records\n";
+
+            char name[64];
+            std::snprintf(name, sizeof(name), "  %2u threads, %s", threads,
+                          order == e_Order::InOrder ? "in order" : "unordered");
+            bench::report(name, seconds, text.size());
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <map>
+#include <vector>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Building and searching objects of various sizes, comparing the flat Object
+  against the std::map<String, Value> it replaced. Objects are searched by
+  C string and by a Key made beforehand.
+*/
+
+typedef std::map<jsonish::String, jsonish::Value> map_object;
+
+static jsonish::String make_string(const std::string& s)
+{
+    return jsonish::String(s.data(), s.data() + s.size());
+}
+
+static void build(map_object& m, const std::vector<std::string>& keys)
+{
+    m.clear();
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        m.emplace(make_string(keys[i]), jsonish::Value(static_cast<long long>(i)));
+}
+
+static void build(jsonish::Object& o, const std::vector<std::string>& keys)
+{
+    o = jsonish::Object();
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        o.emplace(make_string(keys[i]), jsonish::Value(static_cast<long long>(i)));
+}
+
+static long long lookup(const map_object& m, const std::vector<std::string>& keys)
+{
+    long long sum = 0;
+    for (const auto& key : keys)
+        sum += m.find(make_string(key))->second.get<jsonish::e_JsonType::Integer>();
+    return sum;
+}
+
+static long long lookup(const jsonish::Object& o, const std::vector<std::string>& keys)
+{
+    long long sum = 0;
+    for (const auto& key : keys)
+        sum += o.find(key.c_str())->second.get<jsonish::e_JsonType::Integer>();
+    return sum;
+}
+
+static long long lookup(const jsonish::Object& o, const std::vector<jsonish::Key>& keys)
+{
+    long long sum = 0;
+    for (const auto& key : keys)
+        sum += o.find(key)->second.get<jsonish::e_JsonType::Integer>();
+    return sum;
+}
+
+template <typename ObjectType, typename LookupKey = std::string>
+static void run(const char* name, const std::vector<std::string>& keys, std::size_t total)
+{
+    const std::vector<LookupKey> lookup_keys(keys.begin(), keys.end());
+    const std::size_t rounds = std::max<std::size_t>(total / keys.size(), 1);
+    ObjectType object;
+
+    double seconds = bench::best_seconds([&]()
+        {
+            for (std::size_t r = 0; r < rounds; ++r)
+                build(object, keys);
+            bench::keep(object);
+        });
+    std::printf("  %-8s build  %8.1f ns/member", name, seconds * 1e9 / (rounds * keys.size()));
+
+    long long sum = 0;
+    seconds = bench::best_seconds([&]()
+        {
+            for (std::size_t r = 0; r < rounds; ++r)
+                sum += lookup(object, lookup_keys);
+        });
+    bench::keep(sum);
+    std::printf("   lookup %8.1f ns\n", seconds * 1e9 / (rounds * keys.size()));
+}
+
+int main(int argc, char* argv[])
+{
+    const std::size_t total = bench::size_arg(argc, argv, 1);
+
+    for (std::size_t count : {5, 10, 20, 50, 200})
+    {
+        std::vector<std::string> keys;
+        for (std::size_t i = 0; i < count; ++i)
+            keys.push_back("field_name_" + std::to_string(i * 7919));
+
+        std::cout << count << " keys\n";
+        run<map_object>("map", keys, total);
+        run<jsonish::Object>("Object", keys, total);
+        run<jsonish::Object, jsonish::Key>("Key", keys, total);
+    }
+
+    return 0;
+}
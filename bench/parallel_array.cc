@@ -0,0 +1,48 @@
+#include <iostream>
+#include <thread>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  One large top level array of small objects, parsed into a Document by
+  Parser and by parse_parallel with 1 to 32 threads. Default input is 64 MB.
+*/
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv, 64);
+    const std::string text = bench::object_array(bytes);
+    std::cout << "top level array, " << text.size() / (1024 * 1024) << " MB, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+
+    const char* start = text.data();
+    const char* end = text.data() + text.size();
+
+    Document document;
+    Error error;
+    double seconds = bench::best_seconds([&]()
+        {
+            Parser parser{start, end};
+            parser.parse(document, error);
+            bench::keep(document);
+        });
+    bench::report("  Parser", seconds, text.size());
+
+    for (unsigned int threads : {1u, 2u, 4u, 8u, 16u, 32u})
+    {
+        seconds = bench::best_seconds([&]()
+            {
+                if (!parse_parallel(start, end, threads, document, error))
+                    std::cerr << error.message << '\n';
+                bench::keep(document);
+            });
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "  parse_parallel, %2u threads", threads);
+        bench::report(name, seconds, text.size());
+    }
+
+    return 0;
+}
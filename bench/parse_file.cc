@@ -0,0 +1,63 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sys/resource.h>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Parse a file by mapping it with parse_file and by reading it into a
+  std::string first. Peak RSS is reported after each, the mapped parse runs
+  first so its peak isn't hidden by the copy's.
+*/
+
+static long peak_rss_mb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024 * 1024);
+#else
+    return usage.ru_maxrss / 1024;
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv, 64);
+    const char* path = "parse_file_bench.json";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << bench::object_array(bytes);
+    }
+    std::cout << "parse a " << bytes / (1024 * 1024) << " MB file, peak RSS before " << peak_rss_mb() << " MB\n";
+
+    Error error;
+    double seconds = bench::best_seconds([&]()
+        {
+            Document document;
+            if (!parse_file(path, document, error))
+                std::cerr << error.message << '\n';
+            bench::keep(document);
+        });
+    bench::report("  parse_file", seconds, bytes);
+    std::cout << "    peak RSS " << peak_rss_mb() << " MB\n";
+
+    seconds = bench::best_seconds([&]()
+        {
+            std::ifstream in(path, std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+            Document document;
+            Parser parser{text};
+            parser.parse(document, error);
+            bench::keep(document);
+        });
+    bench::report("  read into std::string + parse", seconds, bytes);
+    std::cout << "    peak RSS " << peak_rss_mb() << " MB\n";
+
+    std::remove(path);
+    return 0;
+}
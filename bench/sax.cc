@@ -0,0 +1,67 @@
+#include <iostream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Sum the "id" field of every record, once by building the whole tree and
+  once with a Reader handler that never builds a Value.
+*/
+
+struct id_sum
+{
+    long long sum = 0;
+    bool next_is_id = false;
+
+    bool start_object()                    { return true; }
+    bool end_object()                      { return true; }
+    bool start_array()                     { next_is_id = false; return true; }
+    bool end_array()                       { return true; }
+    bool key(const jsonish::String& str)   { next_is_id = str.equals("id", 2); return true; }
+    bool string(const jsonish::String&)    { return true; }
+    bool floating_point(double)            { return true; }
+    bool boolean(bool)                     { return true; }
+    bool null()                            { return true; }
+
+    bool integer(long long i)
+    {
+        if (next_is_id)
+            sum += i;
+        next_is_id = false;
+        return true;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv);
+    std::string text = bench::object_array(bytes);
+    std::cout << "sum of ids, " << text.size() / (1024 * 1024) << " MB\n";
+
+    double seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            Document document;
+            Error error;
+            parser.parse(document, error);
+
+            long long sum = 0;
+            for (const auto& record : document.root().get<e_JsonType::Array>())
+                sum += record.get<e_JsonType::Object>()["id"].get<e_JsonType::Integer>();
+            bench::keep(sum);
+        });
+    bench::report("  Document parse + walk", seconds, text.size());
+
+    seconds = bench::best_seconds([&]()
+        {
+            Reader reader{text};
+            id_sum handler;
+            Error error;
+            reader.parse(handler, error);
+            bench::keep(handler.sum);
+        });
+    bench::report("  Reader handler", seconds, text.size());
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <cstring>
+#include <iostream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+#include "../jsonish_simd.hpp"
+
+/*
+  Compares the string body kernels against the original byte at a time loop,
+  first in isolation and then through a full parse of string heavy documents.
+  The kernels stop at backslashes too, so text with escapes is only parsed.
+  The UTF-8 validating kernels and each parse are also timed with validation
+  on.
+*/
+
+static const char* byte_loop(const char* pos, const char* end)
+{
+    while (pos != end)
+    {
+        if (*pos++ == '"')
+            return pos - 1;
+    }
+    return end;
+}
+
+template <typename Find>
+static std::size_t count_strings(const std::string& text, Find find)
+{
+    std::size_t count = 0;
+    const char* pos = text.data();
+    const char* end = pos + text.size();
+    while ((pos = find(pos, end)) != end)
+    {
+        pos = find(pos + 1, end);
+        if (pos == end)
+            break;
+        ++pos;
+        ++count;
+    }
+    return count;
+}
+
+//the validating kernels in the shape of the others
+template <const char* (*Find)(const char*, const char*, bool&)>
+static const char* validating(const char* start, const char* end)
+{
+    bool escaped = false;
+    return Find(start, end, escaped);
+}
+
+template <typename Find>
+static void run_kernel(const char* name, const std::string& text, Find find)
+{
+    std::size_t count = 0;
+    double seconds = bench::best_seconds([&]() { count = count_strings(text, find); });
+    bench::keep(count);
+    bench::report(name, seconds, text.size());
+}
+
+static void run_parse(const char* name, const std::string& text, jsonish::impl::e_SimdLevel level,
+                      bool validate_utf8 = false)
+{
+    using namespace jsonish;
+
+    impl::set_simd_level(level);
+    if (impl::simd_level() != level)
+        return;
+
+    double seconds = bench::best_seconds([&]()
+        {
+            Parser parser{text};
+            parser.validate_utf8(validate_utf8);
+            Value v = parser.parse([](const Error& e) { std::cerr << e.message << '\n'; });
+            bench::keep(v);
+        });
+    bench::report(name, seconds, text.size());
+}
+
+//two and three byte UTF-8 in place of some letters
+static std::string accented(const std::string& text)
+{
+    std::string result;
+    for (char c : text)
+    {
+        if (c == 'e')
+            result += "\xc3\xa9";
+        else if (c == 'E')
+            result += "\xe2\x82\xac";
+        else
+            result += c;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish::impl;
+
+    const auto bytes = bench::size_arg(argc, argv);
+
+    struct { const char* label; std::size_t min; std::size_t max; std::size_t escape_every; } shapes[] =
+    {
+        { "short strings (4-16)",       4,    16,   0 },
+        { "log lines (60-200)",         60,   200,  0 },
+        { "base64 blobs (1k-8k)",       1024, 8192, 0 },
+        { "escaped log lines (60-200)", 60,   200,  8 },
+        { "accented log lines (60-200)", 60,  200,  0 },
+        { "accented short strings (4-16)", 4, 16,   0 }
+    };
+
+    for (const auto& shape : shapes)
+    {
+        std::string text = bench::string_array(bytes, shape.min, shape.max, 42, shape.escape_every);
+        if (std::strncmp(shape.label, "accented", 8) == 0)
+            text = accented(text);
+        std::cout << shape.label << ", " << text.size() / (1024 * 1024) << " MB\n";
+
+        if (!shape.escape_every)
+        {
+            run_kernel("  kernel: byte loop", text, byte_loop);
+            run_kernel("  kernel: scalar", text, find_string_special_scalar);
+#ifdef JSONISH_X86_SIMD
+            run_kernel("  kernel: sse2", text, find_string_special_sse2);
+            if (detected_simd_level() >= e_SimdLevel::AVX2)
+                run_kernel("  kernel: avx2", text, find_string_special_avx2);
+#endif
+            run_kernel("  kernel: scalar, utf8", text, validating<find_string_special_utf8_scalar>);
+#ifdef JSONISH_X86_SIMD
+            run_kernel("  kernel: sse2, utf8", text, validating<find_string_special_utf8_sse2>);
+            if (detected_simd_level() >= e_SimdLevel::SSSE3)
+                run_kernel("  kernel: ssse3, utf8", text, validating<find_string_special_utf8_ssse3>);
+            if (detected_simd_level() >= e_SimdLevel::AVX2)
+                run_kernel("  kernel: avx2, utf8", text, validating<find_string_special_utf8_avx2>);
+#endif
+        }
+
+        run_parse("  parse: scalar", text, e_SimdLevel::Scalar);
+        run_parse("  parse: sse2", text, e_SimdLevel::SSE2);
+        run_parse("  parse: avx2", text, e_SimdLevel::AVX2);
+        run_parse("  parse: scalar, utf8", text, e_SimdLevel::Scalar, true);
+        run_parse("  parse: sse2, utf8", text, e_SimdLevel::SSE2, true);
+        run_parse("  parse: ssse3, utf8", text, e_SimdLevel::SSSE3, true);
+        run_parse("  parse: avx2, utf8", text, e_SimdLevel::AVX2, true);
+        set_simd_level(detected_simd_level());
+    }
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <sstream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Serialize a Document of small records, compact and pretty, through an
+  ostringstream, into a reused std::string, and through a Sink that only
+  counts the bytes it is handed.
+*/
+
+template <unsigned int IndentWidth>
+static void run(const char* name, const jsonish::Value& root)
+{
+    using namespace jsonish;
+
+    std::ostringstream probe;
+    write_pretty<IndentWidth>(probe, root);
+    const auto bytes = probe.str().size();
+    std::cout << name << ", " << bytes / (1024 * 1024) << " MB of output\n";
+
+    double seconds = bench::best_seconds([&]()
+        {
+            std::ostringstream out;
+            write_pretty<IndentWidth>(out, root);
+            bench::keep(out);
+        });
+    bench::report("  ostringstream", seconds, bytes);
+
+    std::string buffer;
+    seconds = bench::best_seconds([&]()
+        {
+            buffer.clear();
+            write_pretty<IndentWidth>(buffer, root);
+            bench::keep(buffer);
+        });
+    bench::report("  std::string", seconds, bytes);
+
+    std::size_t handed = 0;
+    const Sink sink = [&handed](const char*, std::size_t size) { handed += size; };
+    seconds = bench::best_seconds([&]()
+        {
+            write_pretty<IndentWidth>(sink, root);
+        });
+    bench::report("  Sink, 64 KB blocks", seconds, bytes);
+    bench::keep(handed);
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace jsonish;
+
+    const auto bytes = bench::size_arg(argc, argv);
+    const std::string text = bench::object_array(bytes);
+
+    Document document;
+    Parser parser{text};
+    parser.parse(document, [](const Error& e) { std::cerr << e.message << '\n'; });
+
+    run<0>("compact", document.root());
+    run<4>("pretty", document.root());
+    return 0;
+}
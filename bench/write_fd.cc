@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Write a parsed document to a temporary file: through an ostringstream and
+  one write, through a Sink calling write for every 64 KB block, and with
+  write_fd, which gathers the pieces into writev calls and takes long
+  strings straight from the input.
+*/
+
+static void run(const char* name, const std::string& text)
+{
+    using namespace jsonish;
+
+    Document document;
+    Parser parser{text};
+    parser.parse(document, [](const Error& e) { std::cerr << e.message << '\n'; });
+    std::cout << name << ", " << text.size() / (1024 * 1024) << " MB\n";
+
+    std::FILE* file = std::tmpfile();
+    const int fd = fileno(file);
+    auto rewind = [fd]()
+    {
+        lseek(fd, 0, SEEK_SET);
+        bench::keep(ftruncate(fd, 0));
+    };
+
+    double seconds = bench::best_seconds([&]()
+        {
+            rewind();
+            std::ostringstream out;
+            jsonish::write(out, document.root());
+            const auto s = out.str();
+            bench::keep(::write(fd, s.data(), s.size()));
+        });
+    bench::report("  ostringstream + write", seconds, text.size());
+
+    std::size_t calls = 0;
+    const Sink sink = [fd, &calls](const char* data, std::size_t size)
+    {
+        ++calls;
+        bench::keep(::write(fd, data, size));
+    };
+    seconds = bench::best_seconds([&]()
+        {
+            rewind();
+            jsonish::write(sink, document.root());
+        });
+    bench::report("  Sink + write per block", seconds, text.size());
+
+    Error error;
+    seconds = bench::best_seconds([&]()
+        {
+            rewind();
+            write_fd(fd, document.root(), error);
+        });
+    bench::report("  write_fd", seconds, text.size());
+
+    bench::keep(calls);
+    std::fclose(file);
+}
+
+int main(int argc, char* argv[])
+{
+    const auto bytes = bench::size_arg(argc, argv);
+    run("small records", bench::object_array(bytes));
+    run("long strings", bench::string_array(bytes, 256, 4096));
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <sstream>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Pretty print deeply nested documents, where most of the output is
+  indentation: an ostringstream and a std::string with the indentation
+  width as a template parameter, and a std::string with tabs chosen at
+  run time.
+*/
+
+static std::string nested(std::size_t bytes, unsigned int depth)
+{
+    std::string result = "[";
+    while (result.size() < bytes)
+    {
+        if (result.size() > 1)
+            result += ",";
+        for (unsigned int level = 0; level < depth; ++level)
+            result += "{\"id\":" + std::to_string(level) + ",\"tags\":[\"a\",\"b\"],\"child\":";
+        result += "null";
+        result += std::string(depth, '}');
+    }
+    result += "]";
+    return result;
+}
+
+static void run(const char* name, const std::string& text)
+{
+    using namespace jsonish;
+
+    Document document;
+    Parser parser{text};
+    parser.parse(document, [](const Error& e) { std::cerr << e.message << '\n'; });
+    const Value& root = document.root();
+
+    std::ostringstream probe;
+    write_pretty(probe, root);
+    const auto bytes = probe.str().size();
+    std::cout << name << ", " << bytes / (1024 * 1024) << " MB of output\n";
+
+    double seconds = bench::best_seconds([&]()
+        {
+            std::ostringstream out;
+            write_pretty<4>(out, root);
+            bench::keep(out);
+        });
+    bench::report("  ostringstream, <4>", seconds, bytes);
+
+    std::string buffer;
+    seconds = bench::best_seconds([&]()
+        {
+            buffer.clear();
+            write_pretty<4>(buffer, root);
+            bench::keep(buffer);
+        });
+    bench::report("  std::string, <4>", seconds, bytes);
+
+    seconds = bench::best_seconds([&]()
+        {
+            buffer.clear();
+            write_pretty(buffer, root, Indent{1, '\t'});
+            bench::keep(buffer);
+        });
+    bench::report("  std::string, Indent{1, '\\t'}", seconds, buffer.size());
+}
+
+int main(int argc, char* argv[])
+{
+    const auto bytes = bench::size_arg(argc, argv, 4);
+    run("depth 8", nested(bytes, 8));
+    run("depth 32", nested(bytes, 32));
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench.hpp"
+#include "../jsonish.hpp"
+
+/*
+  Write an Array of strings built in the program, so every one of them is
+  escaped as it is written. The string kernel that finds what needs escaping
+  is compared with escaping a byte at a time, and with copying the strings
+  as they are, which is what escaping can at best come close to.
+*/
+
+static void byte_loop(std::string& out, const std::vector<std::string>& texts)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out += '[';
+    for (const auto& text : texts)
+    {
+        if (out.size() > 1)
+            out += ',';
+        out += '"';
+        for (unsigned char c : text)
+        {
+            switch (c)
+            {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b";  break;
+            case '\f': out += "\\f";  break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (c < 0x20)
+                {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xf];
+                }
+                else
+                {
+                    out += static_cast<char>(c);
+                }
+                break;
+            }
+        }
+        out += '"';
+    }
+    out += ']';
+}
+
+static void copy_only(std::string& out, const std::vector<std::string>& texts)
+{
+    out += '[';
+    for (const auto& text : texts)
+    {
+        if (out.size() > 1)
+            out += ',';
+        out += '"';
+        out += text;
+        out += '"';
+    }
+    out += ']';
+}
+
+//log lines of printable ASCII, with about one character in escape_every one that needs escaping
+static std::vector<std::string> make_texts(std::size_t bytes, std::size_t escape_every)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/ .:-_";
+    static const char escaped[] = { '"', '\\', '\n', '\t', '\x01' };
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<std::size_t> length(60, 200);
+    std::uniform_int_distribution<std::size_t> letter(0, sizeof(alphabet) - 2);
+    std::uniform_int_distribution<std::size_t> escape(0, escape_every ? escape_every - 1 : 0);
+    std::uniform_int_distribution<std::size_t> which(0, sizeof(escaped) - 1);
+
+    std::vector<std::string> texts;
+    std::size_t total = 0;
+    while (total < bytes)
+    {
+        std::string text;
+        for (std::size_t n = length(rng); n > 0; --n)
+            text += escape_every && escape(rng) == 0 ? escaped[which(rng)] : alphabet[letter(rng)];
+        total += text.size();
+        texts.push_back(std::move(text));
+    }
+    return texts;
+}
+
+static void run(const char* label, const std::vector<std::string>& texts)
+{
+    using namespace jsonish;
+
+    Array array;
+    for (const auto& text : texts)
+        array.emplace_back(String(text.data(), text.data() + text.size()));
+    const Value root(std::move(array));
+
+    std::string out;
+    write(out, root);
+    const auto bytes = out.size();
+    std::cout << label << ", " << bytes / (1024 * 1024) << " MB of output\n";
+
+    double seconds = bench::best_seconds([&]()
+        {
+            out.clear();
+            copy_only(out, texts);
+            bench::keep(out);
+        });
+    bench::report("  copy, no escaping", seconds, bytes);
+
+    seconds = bench::best_seconds([&]()
+        {
+            out.clear();
+            byte_loop(out, texts);
+            bench::keep(out);
+        });
+    bench::report("  byte loop", seconds, bytes);
+
+    seconds = bench::best_seconds([&]()
+        {
+            out.clear();
+            write(out, root);
+            bench::keep(out);
+        });
+    bench::report("  jsonish::write", seconds, bytes);
+}
+
+int main(int argc, char* argv[])
+{
+    const auto bytes = bench::size_arg(argc, argv);
+
+    run("ASCII log lines (60-200)", make_texts(bytes, 0));
+    run("escape heavy log lines (60-200)", make_texts(bytes, 8));
+    return 0;
+}
@@ -24,55 +24,175 @@
 */
 
 #include "jsonish.hpp"
+#include "jsonish_simd.hpp"
+#include "jsonish_number.hpp"
+#include <atomic>
 #include <cctype>
-#include <cerrno>
-#include <climits>
-#include <cmath>
 #include <cstdlib>
 #include <iterator>
+#include <mutex>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 
 namespace jsonish
 {
 
-Value::Value() : m_type{e_JsonType::Null} { }
+namespace impl
+{
+
+static const std::size_t s_first_block_size = 64 * 1024;
+static const std::size_t s_max_block_size = 16 * 1024 * 1024;
+
+arena::arena() : m_blocks(nullptr), m_pos(nullptr), m_end(nullptr), m_next_size(s_first_block_size)
+{
+}
+
+arena::~arena()
+{
+    while (m_blocks)
+    {
+        auto next = m_blocks->next;
+        ::operator delete(m_blocks);
+        m_blocks = next;
+    }
+}
+
+void* arena::allocate_slow(std::size_t size, std::size_t alignment)
+{
+    auto block_size = std::max(m_next_size, sizeof(block) + size + alignment);
+    auto b = static_cast<block*>(::operator new(block_size));
+    b->size = block_size;
+    b->next = m_blocks;
+    m_blocks = b;
+
+    m_pos = reinterpret_cast<char*>(b + 1);
+    m_end = reinterpret_cast<char*>(b) + block_size;
+    m_next_size = std::min(m_next_size * 2, s_max_block_size);
+
+    return allocate(size, alignment);
+}
+
+void arena::clear()
+{
+    if (!m_blocks)
+        return;
+
+    auto b = m_blocks->next;
+    while (b)
+    {
+        auto next = b->next;
+        ::operator delete(b);
+        b = next;
+    }
+
+    m_blocks->next = nullptr;
+    m_pos = reinterpret_cast<char*>(m_blocks + 1);
+    m_end = reinterpret_cast<char*>(m_blocks) + m_blocks->size;
+}
+
+std::size_t arena::capacity() const
+{
+    std::size_t result = 0;
+    for (auto b = m_blocks; b; b = b->next)
+        result += b->size;
+    return result;
+}
+
+//heap Objects and Arrays alive, while there are none no Document's tree can hold one
+static std::atomic<std::size_t> s_heap_nodes(0);
+
+template <typename T, typename... Args>
+static inline T* new_heap_node(Args&&... args)
+{
+    s_heap_nodes.fetch_add(1, std::memory_order_relaxed);
+    return new T(std::forward<Args>(args)...);
+}
+
+//Objects and Arrays live wherever their allocator puts their elements
+template <typename T>
+static inline T* new_node(T&& container)
+{
+    auto a = container.get_allocator().get_arena();
+    if (a)
+        return new (a->allocate(sizeof(T), alignof(T))) T(std::move(container));
+    return new_heap_node<T>(std::move(container));
+}
+
+//arena nodes are never destroyed, the arena releases them along with their elements
+template <typename T>
+static inline void delete_node(T* node)
+{
+    if (node && !node->get_allocator().get_arena())
+    {
+        delete node;
+        s_heap_nodes.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+//shared by every lazy container of one Document, lives in its arena
+struct lazy_context
+{
+    arena* memory;
+    Error error;
+    bool validate_utf8;
+};
+
+//the source text of a container that hasn't been parsed yet
+struct lazy_node
+{
+    const char* start;
+    const char* end;
+    lazy_context* context;
+};
+
+} //impl
+
+Value::Value() : m_type{e_JsonType::Null}, m_lazy{false} { }
 
-Value::Value(const Object& obj) : m_type{e_JsonType::Object}, m_object{new Object(obj)} { }
+Value::Value(const Object& obj) : m_type{e_JsonType::Object}, m_lazy{false}, m_object{impl::new_heap_node<Object>(obj)} { }
 
 Value::Value(Object&& obj) 
     : m_type{e_JsonType::Object}, 
-      m_object{new Object(std::forward<Object>(obj))}
+      m_lazy{false},
+      m_object{impl::new_node(std::forward<Object>(obj))}
 {
 }
 
-Value::Value(const Array& arr) : m_type{e_JsonType::Array}, m_array{new Array(arr)} { }
+Value::Value(const Array& arr) : m_type{e_JsonType::Array}, m_lazy{false}, m_array{impl::new_heap_node<Array>(arr)} { }
 
 Value::Value(Array&& arr) : 
     m_type{e_JsonType::Array},
-    m_array{new Array(std::forward<Array>(arr))}
+    m_lazy{false},
+    m_array{impl::new_node(std::forward<Array>(arr))}
 {
 }
 
-Value::Value(const String& str) : m_type{e_JsonType::String}, m_string{str} { }
+Value::Value(const String& str) : m_type{e_JsonType::String}, m_lazy{false}, m_string{str} { }
 
-Value::Value(int i) : m_type{e_JsonType::Integer}, m_integer{i} { }
+Value::Value(int i) : m_type{e_JsonType::Integer}, m_lazy{false}, m_integer{i} { }
 
-Value::Value(long long i) : m_type{e_JsonType::Integer}, m_integer{i} { }
+Value::Value(long long i) : m_type{e_JsonType::Integer}, m_lazy{false}, m_integer{i} { }
 
-Value::Value(double d) : m_type{e_JsonType::FloatingPoint}, m_floating_point{d} { }
+Value::Value(double d) : m_type{e_JsonType::FloatingPoint}, m_lazy{false}, m_floating_point{d} { }
 
-Value::Value(bool b) : m_type{b ? e_JsonType::True : e_JsonType::False} { }
+Value::Value(bool b) : m_type{b ? e_JsonType::True : e_JsonType::False}, m_lazy{false} { }
+
+Value::Value(e_JsonType type, impl::lazy_node* node) : m_type{type}, m_lazy{true}, m_lazy_node{node} { }
 
 void Value::copy_guts(const Value& o)
 {
+    //copies are always complete trees
+    if (o.m_lazy)
+        const_cast<Value&>(o).materialize();
+
     switch (m_type)
     {
     case e_JsonType::Object:
-        m_object = new Object(*o.m_object);
+        m_object = impl::new_heap_node<Object>(*o.m_object);
         break;
     case e_JsonType::Array:
-        m_array = new Array(*o.m_array);
+        m_array = impl::new_heap_node<Array>(*o.m_array);
         break;
     case e_JsonType::String:
         new (&m_string) String(o.m_string);
@@ -88,8 +208,11 @@ void Value::copy_guts(const Value& o)
     }
 }
 
-void Value::move_guts(Value&& o)
+void Value::move_guts(Value&& o) noexcept
 {
+    m_lazy = o.m_lazy;
+    o.m_lazy = false;
+
     switch (m_type)
     {
     case e_JsonType::Object:
@@ -116,928 +239,1751 @@ void Value::move_guts(Value&& o)
     o.m_type = e_JsonType::Null;
 }
 
-Value::Value(const Value& o) : m_type(o.m_type) { copy_guts(o); }
-Value::Value(Value&& o) : m_type(o.m_type) { move_guts(std::forward<Value>(o)); }
+void Value::destroy() noexcept
+{
+    //lazy nodes live in their Document's arena
+    if (m_lazy)
+        return;
+
+    switch (m_type)
+    {
+    case e_JsonType::Object: impl::delete_node(m_object); break;
+    case e_JsonType::Array:  impl::delete_node(m_array);  break;
+    default:                                              break;
+    }
+}
+
+Value::Value(const Value& o) : m_type(o.m_type), m_lazy(false) { copy_guts(o); }
+Value::Value(Value&& o) noexcept : m_type(o.m_type) { move_guts(std::forward<Value>(o)); }
 
 Value& Value::operator=(const Value& o)
 {
     if (this != &o)
-        copy_guts(o);
+    {
+        Value copy(o);
+        *this = std::move(copy);
+    }
     return *this;
 }
 
-Value& Value::operator=(Value&& o)
+Value& Value::operator=(Value&& o) noexcept
 {
-    m_type = o.m_type;
-    move_guts(std::forward<Value>(o));
+    if (this != &o)
+    {
+        //o may live inside this value, take it out before destroying anything
+        Value tmp(std::forward<Value>(o));
+        destroy();
+        m_type = tmp.m_type;
+        move_guts(std::move(tmp));
+    }
     return *this;
 }
 
 Value::~Value()
 {
-    switch (m_type)
+    destroy();
+}
+
+void Value::materialize()
+{
+    auto node = m_lazy_node;
+    Parser parser(node->start, node->end);
+    parser.validate_utf8(node->context->validate_utf8);
+    Value result;
+    Error error;
+    if (!parser.materialize(node->context, result, error))
     {
-    case e_JsonType::Object: delete m_object;       break;
-    case e_JsonType::Array:  delete m_array;        break;
-    default:                                        break;
+        if (!node->context->error.message)
+            node->context->error = error;
+
+        //the error is reported through the Document, the container is left empty
+        impl::allocator<Value> memory(node->context->memory);
+        if (m_type == e_JsonType::Object)
+            result = Value(Object(Object::allocator_type(memory)));
+        else
+            result = Value(Array(memory));
     }
+
+    move_guts(std::move(result));
 }
 
+void Value::release_heap_nodes()
+{
+    //trees can be deeper than the call stack, so the containers to visit are kept in a vector
+    std::vector<Value*> pending;
+    if ((m_type == e_JsonType::Object || m_type == e_JsonType::Array) &&
+        impl::s_heap_nodes.load(std::memory_order_relaxed))
+    {
+        pending.push_back(this);
+    }
+
+    while (!pending.empty())
+    {
+        auto v = pending.back();
+        pending.pop_back();
 
-template <typename T>
-constexpr typename std::underlying_type<T>::type enum_value(T val)
-{ return static_cast<typename std::underlying_type<T>::type>(val); }
+        //lazy containers only hold source text
+        if (v->m_lazy)
+            continue;
 
-enum class e_LexerError : uint8_t
+        const bool heap = v->m_type == e_JsonType::Object ? !v->m_object->get_allocator().get_arena()
+                                                          : !v->m_array->get_allocator().get_arena();
+        if (heap)
+        {
+            v->destroy();
+            v->m_type = e_JsonType::Null;
+            continue;
+        }
+
+        auto visit = [&pending](Value& child)
+        {
+            if (child.m_type == e_JsonType::Object || child.m_type == e_JsonType::Array)
+                pending.push_back(&child);
+        };
+        if (v->m_type == e_JsonType::Object)
+        {
+            for (auto& member : *v->m_object)
+                visit(member.second);
+        }
+        else
+        {
+            for (auto& element : *v->m_array)
+                visit(element);
+        }
+    }
+}
+
+
+const std::size_t String::s_escaped;
+
+static inline unsigned int hex_value(char c)
 {
-    UnknownCharacter = 0,
-    UnterminatedString,
-    UnexpectedEnd,
-    ExpectedTrue,
-    ExpectedFalse,
-    ExpectedNull,
-    BadNumber,
-    Count
-};
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    return (c | 0x20) - 'a' + 10;
+}
 
-static const char* s_lexer_errors[enum_value(e_LexerError::Count)] =
+//the code unit of the four hex digits at p
+static inline unsigned int hex4(const char* p)
 {
-    "Unknown Character",
-    "Unterminated string",
-    "Unexpected end of input",
-    "Expected 'true'",
-    "Expected 'false'",
-    "Expected 'null'",
-    "Malformed number"
-};
+    return hex_value(p[0]) << 12 | hex_value(p[1]) << 8 | hex_value(p[2]) << 4 | hex_value(p[3]);
+}
 
-Lexer::Lexer(const char* start, const char* end)
-    : m_pos(start),
-      m_end(end)
+static inline char* write_utf8(char* out, unsigned int code)
 {
+    if (code < 0x80)
+    {
+        *out++ = static_cast<char>(code);
+    }
+    else if (code < 0x800)
+    {
+        *out++ = static_cast<char>(0xc0 | code >> 6);
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+    }
+    else if (code < 0x10000)
+    {
+        *out++ = static_cast<char>(0xe0 | code >> 12);
+        *out++ = static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+    }
+    else
+    {
+        *out++ = static_cast<char>(0xf0 | code >> 18);
+        *out++ = static_cast<char>(0x80 | (code >> 12 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+    }
+    return out;
 }
 
-Lexer::Token Lexer::next()
+char* String::unescape(char* out) const
 {
-    while (m_pos != m_end)
+    auto pos = begin();
+    const auto stop = end();
+    while (pos != stop)
     {
-        auto start = m_pos;
-        char c = *m_pos++;
+        auto backslash = static_cast<const char*>(std::memchr(pos, '\\', stop - pos));
+        if (!backslash)
+            backslash = stop;
+        std::memcpy(out, pos, backslash - pos);
+        out += backslash - pos;
+        pos = backslash;
+        if (stop - pos < 2)
+            break;
+
+        //the Lexer only lets valid escapes through, anything else is copied as it is
+        const char c = pos[1];
+        pos += 2;
         switch (c)
         {
-            //whitespace
-        case ' ':
-        case '\n':
-        case '\t':
-        case '\r':
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u':
+            if (stop - pos < 4)
+            {
+                *out++ = c;
+                break;
+            }
+            {
+                auto code = hex4(pos);
+                pos += 4;
+                if (code >= 0xd800 && code < 0xdc00 && stop - pos >= 6 && pos[0] == '\\' && pos[1] == 'u')
+                {
+                    auto low = hex4(pos + 2);
+                    if (low >= 0xdc00 && low < 0xe000)
+                    {
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                        pos += 6;
+                    }
+                }
+
+                //a surrogate without its other half has no UTF-8 form
+                if (code >= 0xd800 && code < 0xe000)
+                    code = 0xfffd;
+                out = write_utf8(out, code);
+            }
             break;
-            
-            //symbols
-        case '{':
-            return Token(e_Token::LeftBrace, start, m_pos);
-        case '}':
-            return Token(e_Token::RightBrace, start, m_pos);
-        case '[':
-            return Token(e_Token::LeftBracket, start, m_pos);
-        case ']':
-            return Token(e_Token::RightBracket, start, m_pos);
-        case ':':
-            return Token(e_Token::Colon, start, m_pos);
-        case ',':
-            return Token(e_Token::Comma, start, m_pos);
-
-            //string
-        case '"':
-            return read_string();
-
-            //Numbers
-        case '-':
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-            return read_number();
-
-            //true, false, null
-        case 't':
-            return read_potential_true();
-        case 'f':
-            return read_potential_false();
-        case 'n':
-            return read_potential_null();
-
         default:
-            return Token(m_pos,
-                         s_lexer_errors[enum_value(e_LexerError::UnknownCharacter)]);
+            *out++ = c;
+            break;
         }
     }
-
-    return Token(e_Token::EndOfInput, nullptr, nullptr);
+    return out;
 }
 
-Lexer::Token Lexer::peek()
+/*
+  The decoded text of an escaped String, in a buffer on the stack unless it
+  is long, so keys with escapes are compared and hashed without allocating.
+*/
+class decoded_text
 {
-    auto start = m_pos;
-    auto result = next();
-    m_pos = start;
+  public:
+    explicit decoded_text(const String& str)
+    {
+        //decoding never makes the text longer
+        if (str.size() > sizeof(m_buffer))
+            m_long.resize(str.size());
+        m_start = str.size() > sizeof(m_buffer) ? &m_long[0] : m_buffer;
+        m_end = str.unescape(m_start);
+    }
 
-    return result;
-}
+    const char* data() const { return m_start; }
+    std::size_t size() const { return m_end - m_start; }
 
-Lexer::Token Lexer::read_string()
+  private:
+    char m_buffer[256];
+    std::string m_long;
+    char* m_start;
+    char* m_end;
+};
+
+bool String::equals_escaped(const char* str, std::size_t length) const
 {
-    auto start = m_pos;
-    while (m_pos != m_end)
-    {
-        if (*m_pos++ == '"')
-        {
-            //the quote has been skipped
-            return Token(e_Token::String, start, m_pos - 1);
-        }
-    } 
+    if (length > size())
+        return false;
 
-    return Token(start, s_lexer_errors[enum_value(e_LexerError::UnterminatedString)]);
+    const decoded_text decoded(*this);
+    return decoded.size() == length && std::memcmp(decoded.data(), str, length) == 0;
 }
 
-Lexer::Token Lexer::read_number()
+
+const impl::interned_key* impl::intern(const char* str, std::size_t length)
 {
-    auto start = m_pos - 1;
-    bool is_fp = false;
-    while (m_pos != m_end)
-    {
-        if (*m_pos == '.')
-        {
-            if (*start == '-' && m_pos == start + 1)
-                return Token(start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
-            is_fp = true;
-        }
-        else if (!std::isdigit(*m_pos))
-        {
-            auto t = is_fp ? e_Token::Float : e_Token::Integer;
-            return Token(t, start, m_pos);
-        }
+    //never destroyed, so Keys in other static objects stay valid at exit
+    static std::mutex* s_mutex = new std::mutex;
+    static std::unordered_map<std::string, std::uint64_t>* s_keys = new std::unordered_map<std::string, std::uint64_t>;
+
+    std::lock_guard<std::mutex> lock(*s_mutex);
+    auto result = s_keys->emplace(std::string(str, length), 0);
+    if (result.second)
+        result.first->second = hash_bytes(str, length);
+    return &*result.first;
+}
 
-        m_pos++;
-    }
 
-    return Token(start, s_lexer_errors[enum_value(e_LexerError::UnexpectedEnd)]);
+const std::size_t Object::index_threshold;
+
+Object::Object(std::initializer_list<std::pair<const String, Value>> ilist)
+{
+    m_pairs.reserve(ilist.size());
+    m_hashes.reserve(ilist.size());
+    for (const auto& pair : ilist)
+        emplace(pair.first, Value(pair.second));
 }
 
-Lexer::Token Lexer::read_potential_true()
+std::pair<Object::iterator, bool> Object::emplace(const String& key, Value&& value)
 {
-    //rue
-    auto start = m_pos - 1;
-    if ((m_pos != m_end) && (*m_pos++ == 'r') &&
-        (m_pos != m_end) && (*m_pos++ == 'u') &&
-        (m_pos != m_end) && (*m_pos++ == 'e'))
+    //keys are found by their decoded text
+    std::size_t position;
+    std::uint64_t hash;
+    if (key.escaped())
+    {
+        const decoded_text decoded(key);
+        hash = impl::hash_bytes(decoded.data(), decoded.size());
+        position = find_index(decoded.data(), decoded.size(), hash);
+    }
+    else
     {
-        return Token(e_Token::True, nullptr, nullptr);
+        hash = impl::hash_bytes(key.begin(), key.size());
+        position = find_index(key.begin(), key.size(), hash);
     }
+    if (position != m_pairs.size())
+        return std::make_pair(m_pairs.begin() + position, false);
 
-    return Token(start, s_lexer_errors[enum_value(e_LexerError::ExpectedTrue)]);
+    m_pairs.emplace_back(key, std::forward<Value>(value));
+    m_hashes.push_back(static_cast<std::uint32_t>(hash));
+
+    if (!m_index.empty() && m_pairs.size() * 2 <= m_index.size())
+        index_insert(position);
+    else if (m_pairs.size() > index_threshold)
+        rebuild_index();
+
+    return std::make_pair(m_pairs.begin() + position, true);
 }
 
-Lexer::Token Lexer::read_potential_false()
+Value& Object::get_or_insert(const String& key)
 {
-    //alse
-    auto start = m_pos - 1;
-    if ((m_pos != m_end) && (*m_pos++ == 'a') &&
-        (m_pos != m_end) && (*m_pos++ == 'l') &&
-        (m_pos != m_end) && (*m_pos++ == 's') &&
-        (m_pos != m_end) && (*m_pos++ == 'e'))
-    {
-        return Token(e_Token::False, nullptr, nullptr);
-    }
-
-    return Token(start, s_lexer_errors[enum_value(e_LexerError::ExpectedFalse)]);
+    return emplace(key, Value()).first->second;
 }
 
-Lexer::Token Lexer::read_potential_null()
+std::size_t Object::find_index(const char* key, std::size_t length, std::uint64_t hash) const
 {
-    //ull
-    auto start = m_pos - 1;
-    if ((m_pos != m_end) && (*m_pos++ == 'u') &&
-        (m_pos != m_end) && (*m_pos++ == 'l') &&
-        (m_pos != m_end) && (*m_pos++ == 'l'))
+    const auto low = static_cast<std::uint32_t>(hash);
+    if (m_index.empty())
     {
-        return Token(e_Token::Null, nullptr, nullptr);
+        for (std::size_t i = 0; i < m_hashes.size(); ++i)
+        {
+            if (m_hashes[i] == low && m_pairs[i].first.equals(key, length))
+                return i;
+        }
+        return m_pairs.size();
     }
 
-    return Token(start, s_lexer_errors[enum_value(e_LexerError::ExpectedNull)]);
+    const std::size_t mask = m_index.size() - 1;
+    for (auto slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        auto entry = m_index[slot];
+        if (!entry)
+            return m_pairs.size();
+        if (m_hashes[entry - 1] == low && m_pairs[entry - 1].first.equals(key, length))
+            return entry - 1;
+    }
 }
 
-Parser::Parser(const char* input) : Parser(input, input + strlen(input) + 1)
+void Object::index_insert(std::size_t position)
 {
+    //the index never outgrows the stored low half of the hash
+    const std::size_t mask = m_index.size() - 1;
+    auto slot = m_hashes[position] & mask;
+    while (m_index[slot])
+        slot = (slot + 1) & mask;
+
+    m_index[slot] = static_cast<std::uint32_t>(position + 1);
 }
 
-Parser::Parser(const char* start, const char* end)
-    : m_start(start),
-      m_end(end),
-      m_lexer(start, end),
-      m_expect(e_Expect::Value),
-      m_context(e_Context::None),
-      m_length(0)
+void Object::rebuild_index()
 {
+    //keep the load factor at or below one half
+    std::size_t slots = 2 * index_threshold;
+    while (slots < m_pairs.size() * 4)
+        slots *= 2;
+
+    m_index.assign(slots, 0);
+    for (std::size_t i = 0; i < m_pairs.size(); ++i)
+        index_insert(i);
 }
 
-Parser::Parser(const std::string& input) : Parser(input.data(), input.data() + input.length())
+
+Document::Document() : m_arena(new impl::arena), m_lazy(nullptr) { }
+
+Document::Document(Document&& o)
+    : m_arena(std::move(o.m_arena)),
+      m_adopted(std::move(o.m_adopted)),
+      m_files(std::move(o.m_files)),
+      m_lazy(o.m_lazy),
+      m_root(std::move(o.m_root))
 {
+    o.m_lazy = nullptr;
 }
 
-
-enum class e_ParseError : uint8_t
+Document::~Document()
 {
-    UnclosedObject = 0,
-    UnclosedArray,
-    TopLevelNotObjectOrArray,
-    ExpectedString,
-    ExpectedStringOrCloseObject,
-    ExpectedColon,
-    ExpectedCommaOrCloseObject,
-    ExpectedCommaOrCloseArray,
-    ExpectedValue,
-    ExpectedEndOfInput,
-    IntegerOverflow,
-    IntegerUnderflow,
-    FloatingPointOverflow,
-    FloatingPointUnderflow,
-    Count
-};
+    m_root.release_heap_nodes();
+}
 
-static const char* s_parse_errors[enum_value(e_ParseError::Count)] =
+Document& Document::operator=(Document&& o)
 {
-    "Unclosed Object",
-    "Unclosed Array",
-    "Top level must be an Object or an Array",
-    "Expected string",
-    "Expected string or '}'",
-    "Expected ':'",
-    "Expected ',' or '}'",
-    "Expected ',' or ']'",
-    "Expected object, array, string, number, true, false, or null",
-    "Expected end of input",
-    "Integer overflow",
-    "Integer underflow",
-    "Floating point overflow",
-    "Floating point underflow"
-};
+    m_root.release_heap_nodes();
+    m_root = std::move(o.m_root);
+    m_arena = std::move(o.m_arena);
+    m_adopted = std::move(o.m_adopted);
+    m_files = std::move(o.m_files);
+    m_lazy = o.m_lazy;
+    o.m_lazy = nullptr;
+    return *this;
+}
 
-/*
-  Token     | top of stack | action
-  ----------------------------------
-     {      | empty        | push Object
-     {      | Value        | push Object
-     
-     }      | empty        | Error
-     }      | Value        | pop until Object at top, make pairs
-     
-     [      | empty        | push Array
-     [      | Value        | push Array
-     
-     ]      | empty        | Error
-     ]      | Value        | pop until Array at top, make Array
-     
-     :      | empty        | Error
-     :      | String       | continue
-     :      | other        | Error
-
-     ,      | Value        | continue
-     ,      | empty        | Error
-
-     String | Value        | push String
-     String | empty        | Error
-
-     Int    | Value        | push Int
-     Int    | empty        | Error
-
-     Float  | Value        | push Number
-     Float  | empty        | Error
-     
-     true   | Value        | push true
-     true   | empty        | Error
-
-     false  | Value        | push false
-     false  | empty        | Error
-
-     null   | Value        | push null
-     null   | empty        | Error
-
-     EOI    | Object       | Done
-     EOI    | Array        | Done
-     EOI    | empty        | Error
-     EOI    | other        | Error
-
-     Error  | anything     | Error
- */
-
-enum class e_Action : uint8_t
-{
-    Push, Pop, Continue, Error, Done
-};
+Object Document::make_object() { return Object(Object::allocator_type(m_arena.get())); }
 
-/*
-  First index is an e_Token.
-  Second represents the type of the top of the stack as a e_JsonType combined with the empty state
-*/
-static const e_Action s_state_table[14][9] =
-{
-    //e_Token::LeftBrace
-    {
-        e_Action::Push, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::RightBrace
-    {
-        e_Action::Error, //empty
-        e_Action::Pop, //e_JsonType::Object
-        e_Action::Pop, //e_JsonType::Array
-        e_Action::Pop, //e_JsonType::String
-        e_Action::Pop, //e_JsonType::Integer
-        e_Action::Pop, //e_JsonType::FloatingPoint
-        e_Action::Pop, //e_JsonType::True
-        e_Action::Pop, //e_JsonType::False
-        e_Action::Pop  //e_JsonType::Null
-    },
-
-    //e_Token::LeftBracket
-    {
-        e_Action::Push, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::RightBracket
-    {
-        e_Action::Error, //empty
-        e_Action::Pop, //e_JsonType::Object
-        e_Action::Pop, //e_JsonType::Array
-        e_Action::Pop, //e_JsonType::String
-        e_Action::Pop, //e_JsonType::Integer
-        e_Action::Pop, //e_JsonType::FloatingPoint
-        e_Action::Pop, //e_JsonType::True
-        e_Action::Pop, //e_JsonType::False
-        e_Action::Pop  //e_JsonType::Null
-    },
-
-    //e_Token::Colon
-    {
-        e_Action::Error, //empty
-        e_Action::Error, //e_JsonType::Object
-        e_Action::Error, //e_JsonType::Array
-        e_Action::Continue, //e_JsonType::String
-        e_Action::Error, //e_JsonType::Integer
-        e_Action::Error, //e_JsonType::FloatingPoint
-        e_Action::Error, //e_JsonType::True
-        e_Action::Error, //e_JsonType::False
-        e_Action::Error  //e_JsonType::Null
-    },
-
-    //e_Token::Comma
-    {
-        e_Action::Error, //empty
-        e_Action::Continue, //e_JsonType::Object
-        e_Action::Continue, //e_JsonType::Array
-        e_Action::Continue, //e_JsonType::String
-        e_Action::Continue, //e_JsonType::Integer
-        e_Action::Continue, //e_JsonType::FloatingPoint
-        e_Action::Continue, //e_JsonType::True
-        e_Action::Continue, //e_JsonType::False
-        e_Action::Continue  //e_JsonType::Null
-    },
-
-    //e_Token::String
-    {
-        e_Action::Error, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::Integer
-    {
-        e_Action::Error, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::Float
-    {
-        e_Action::Error, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::True
-    {
-        e_Action::Error, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::False
-    {
-        e_Action::Error, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::Null
-    {
-        e_Action::Error, //empty
-        e_Action::Push, //e_JsonType::Object
-        e_Action::Push, //e_JsonType::Array
-        e_Action::Push, //e_JsonType::String
-        e_Action::Push, //e_JsonType::Integer
-        e_Action::Push, //e_JsonType::FloatingPoint
-        e_Action::Push, //e_JsonType::True
-        e_Action::Push, //e_JsonType::False
-        e_Action::Push  //e_JsonType::Null
-    },
-
-    //e_Token::EndOfInput
-    {
-        e_Action::Error, //empty
-        e_Action::Done, //e_JsonType::Object
-        e_Action::Done, //e_JsonType::Array
-        e_Action::Error, //e_JsonType::String
-        e_Action::Error, //e_JsonType::Integer
-        e_Action::Error, //e_JsonType::FloatingPoint
-        e_Action::Error, //e_JsonType::True
-        e_Action::Error, //e_JsonType::False
-        e_Action::Error  //e_JsonType::Null
-    },
-
-    //e_Token::Error
-    {
-        e_Action::Error, //empty
-        e_Action::Error, //e_JsonType::Object
-        e_Action::Error, //e_JsonType::Array
-        e_Action::Error, //e_JsonType::String
-        e_Action::Error, //e_JsonType::Integer
-        e_Action::Error, //e_JsonType::FloatingPoint
-        e_Action::Error, //e_JsonType::True
-        e_Action::Error, //e_JsonType::False
-        e_Action::Error  //e_JsonType::Null
-    }
-};
+Array Document::make_array() { return Array(get_allocator()); }
 
-void Parser::reset()
+void Document::clear()
 {
-    m_lexer = Lexer(m_start, m_end);
-    m_stack.clear();
+    m_root.release_heap_nodes();
+    m_root = Value();
+    m_lazy = nullptr;
+    m_adopted.clear();
+    m_files.clear();
+    if (m_arena)
+        m_arena->clear();
+    else
+        m_arena.reset(new impl::arena);
 }
 
-void Parser::reset(const char* input)
+void Document::adopt(Document& other)
 {
-    m_start = input;
-    m_end = m_start + strlen(input) + 1;
-    reset();
+    other.m_root.release_heap_nodes();
+    other.m_root = Value();
+    if (other.m_arena)
+        m_adopted.push_back(std::move(other.m_arena));
+    std::move(other.m_adopted.begin(), other.m_adopted.end(), std::back_inserter(m_adopted));
+    std::move(other.m_files.begin(), other.m_files.end(), std::back_inserter(m_files));
+
+    other.m_adopted.clear();
+    other.m_files.clear();
+    other.m_lazy = nullptr;
+    other.m_arena.reset(new impl::arena);
 }
 
-void Parser::reset(const char* start, const char* end)
+Error Document::lazy_error() const
 {
-    m_start = start;
-    m_end = end;
-    reset();
+    return m_lazy ? m_lazy->error : Error();
 }
 
-void Parser::reset(const std::string& input)
+
+template <typename T>
+constexpr typename std::underlying_type<T>::type enum_value(T val)
+{ return static_cast<typename std::underlying_type<T>::type>(val); }
+
+enum class e_LexerError : uint8_t
+{
+    UnknownCharacter = 0,
+    UnterminatedString,
+    UnexpectedEnd,
+    ExpectedTrue,
+    ExpectedFalse,
+    ExpectedNull,
+    BadNumber,
+    BadEscape,
+    ControlCharacter,
+    InvalidUtf8,
+    Count
+};
+
+static const char* s_lexer_errors[enum_value(e_LexerError::Count)] =
+{
+    "Unknown Character",
+    "Unterminated string",
+    "Unexpected end of input",
+    "Expected 'true'",
+    "Expected 'false'",
+    "Expected 'null'",
+    "Malformed number",
+    "Invalid escape sequence",
+    "Control character in string",
+    "Invalid UTF-8 in string"
+};
+
+Lexer::Lexer(const char* start, const char* end)
+    : m_pos(start),
+      m_end(end),
+      m_last(true),
+      m_validate_utf8(false),
+      m_partial(e_Token::EndOfInput),
+      m_splices(nullptr)
 {
-    m_start = input.data();
-    m_end = input.data() + input.length();
-    reset();
 }
 
-Value Parser::parse(std::function<void(const Error&)> error_fun)
+Lexer::Lexer(impl::arena* splices)
+    : m_pos(nullptr),
+      m_end(nullptr),
+      m_last(false),
+      m_validate_utf8(false),
+      m_partial(e_Token::EndOfInput),
+      m_splices(splices)
+{
+}
+
+void Lexer::feed(const char* start, const char* end)
+{
+    m_pos = start;
+    m_end = end;
+
+    //the old chunk's classification must never be mistaken for the new one's
+    m_block = impl::scan_block();
+}
+
+void Lexer::finish()
 {
-    try
+    m_pos = m_end;
+    m_last = true;
+}
+
+void Lexer::skip_whitespace()
+{
+    while (m_pos != m_end)
     {
-        auto peek = m_lexer.peek();
-        if (peek.type != e_Token::LeftBrace && peek.type != e_Token::LeftBracket)
-        {
-            throw Error(peek.value.start, 
-                        s_parse_errors[enum_value(e_ParseError::TopLevelNotObjectOrArray)]);
-        }
+        if (!m_block.covers(m_pos))
+            impl::classify_block(m_block, m_pos, m_end);
 
-        m_expect = e_Expect::Value;
-        
-        while (true)
+        auto non_whitespace = ~m_block.whitespace >> (m_pos - m_block.base);
+        if (non_whitespace)
         {
-            auto token = m_lexer.next();
-            const auto& action = s_state_table[enum_value(token.type)][top_type()];
-            
-            switch (action)
-            {
-            case e_Action::Push:     push(token);          break;
-            case e_Action::Pop:      pop(token);           break;
-            case e_Action::Continue: comma_colon(token);   break;
-            case e_Action::Error:    error(token);         break;
-            case e_Action::Done:     return done(token);
-            }
+            m_pos += impl::count_trailing_zeros(non_whitespace);
+            return;
         }
+
+        m_pos = m_block.limit;
     }
-    catch (const Error& err)
+}
+
+static inline e_Token structural_token(char c)
+{
+    switch (c)
     {
-        error_fun(err);
-        return Value();
+    case '{': return e_Token::LeftBrace;
+    case '}': return e_Token::RightBrace;
+    case '[': return e_Token::LeftBracket;
+    case ']': return e_Token::RightBracket;
+    case ':': return e_Token::Colon;
+    default:  return e_Token::Comma;
     }
 }
 
-//this is the second index into s_state_table
-unsigned int Parser::top_type() const
+Lexer::Token Lexer::next()
 {
-    if (m_stack.empty())
-        return 0;
-    
-    const auto& top = m_stack.front();
-    return static_cast<unsigned int>(top.value.type()) + 1;
+    if (m_partial != e_Token::EndOfInput)
+        return resume();
+
+    skip_whitespace();
+    if (m_pos == m_end)
+        return Token(m_last ? e_Token::EndOfInput : e_Token::NeedInput, nullptr, nullptr);
+
+    auto start = m_pos;
+    auto bit = std::uint64_t(1) << (m_pos - m_block.base);
+    char c = *m_pos++;
+
+    //the block classification already identified these
+    if (m_block.structural & bit)
+        return Token(structural_token(c), start, m_pos);
+    if (m_block.quote & bit)
+        return read_string();
+
+    switch (c)
+    {
+        //Numbers
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        return read_number();
+
+        //true, false, null
+    case 't':
+        return read_literal(e_Token::True);
+    case 'f':
+        return read_literal(e_Token::False);
+    case 'n':
+        return read_literal(e_Token::Null);
+
+    default:
+        return Token(m_pos,
+                     s_lexer_errors[enum_value(e_LexerError::UnknownCharacter)]);
+    }
 }
 
-namespace impl
+Lexer::Token Lexer::peek()
 {
+    auto start = m_pos;
+    auto result = next();
+    m_pos = start;
 
-static inline bool token_is_value(const Lexer::Token& token)
-{
-    return (token.type == e_Token::LeftBrace   ||
-            token.type == e_Token::LeftBracket ||
-            token.type == e_Token::String      ||
-            token.type == e_Token::Integer     ||
-            token.type == e_Token::Float       ||
-            token.type == e_Token::True        ||
-            token.type == e_Token::False       ||
-            token.type == e_Token::Null);
+    return result;
 }
 
-} //impl
-
-void Parser::check_expect(const Lexer::Token& token) const
+const char* Lexer::skip_container()
 {
-    switch (m_expect)
+    std::size_t depth = 1;
+    std::uint64_t inside = 0;
+    bool escaped = false;
+    for (auto pos = m_pos; pos < m_end; pos = m_block.limit)
     {
-    case e_Expect::Value:
-        if (!impl::token_is_value(token))
-            throw Error(token.value.start, s_parse_errors[enum_value(e_ParseError::ExpectedValue)]);
-        break;
-    case e_Expect::ValueOrClose:
-        if (!impl::token_is_value(token) && 
-            token.type != e_Token::RightBrace &&
-            token.type != e_Token::RightBracket)
-        {
-            throw Error(token.value.start, s_parse_errors[enum_value(e_ParseError::ExpectedValue)]);
-        }
-        break;
-    case e_Expect::CommaOrClose:
+        impl::classify_block(m_block, pos, m_end, escaped);
+        escaped = m_block.escape_carry;
+
+        //opening quotes are inside their string, closing ones are not
+        inside = impl::prefix_xor(m_block.quote) ^ (inside >> 63 ? ~std::uint64_t(0) : 0);
+
+        for (auto bits = m_block.structural & ~inside; bits; bits &= bits - 1)
         {
-            const char* emsg_ptr = nullptr;
-        
-            if (token.type != e_Token::Comma &&
-                token.type != e_Token::RightBrace &&
-                token.type != e_Token::RightBracket)
+            auto p = m_block.base + impl::count_trailing_zeros(bits);
+            switch (*p)
             {
-                if (m_context == e_Context::Object)
-                    emsg_ptr = s_parse_errors[enum_value(e_ParseError::ExpectedCommaOrCloseObject)];
-                else if (m_context == e_Context::Array)
-                    emsg_ptr = s_parse_errors[enum_value(e_ParseError::ExpectedCommaOrCloseArray)];
-                throw Error(token.value.start, emsg_ptr);
+            case '{':
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0)
+                {
+                    //m_block stays valid for the tokens after the container
+                    m_pos = p + 1;
+                    return m_pos;
+                }
+                break;
+            default:
+                break;
             }
+        }
+    }
+
+    m_pos = m_end;
+    return nullptr;
+}
 
-            if (token.type == e_Token::RightBrace && m_context == e_Context::Array)
-                emsg_ptr = s_parse_errors[enum_value(e_ParseError::ExpectedCommaOrCloseArray)];
-            else if (token.type == e_Token::RightBracket && m_context == e_Context::Object)
-                emsg_ptr = s_parse_errors[enum_value(e_ParseError::ExpectedCommaOrCloseObject)];
+/*
+  The length of the escape sequence starting with the backslash at pos, or 0
+  if it is not a valid one. It may be longer than what is left before end.
+*/
+static inline std::size_t escape_length(const char* pos, const char* end)
+{
+    if (end - pos < 2)
+        return 2;
 
-            if (emsg_ptr)
-                throw Error(token.value.start, emsg_ptr);
+    switch (pos[1])
+    {
+    case '"':
+    case '\\':
+    case '/':
+    case 'b':
+    case 'f':
+    case 'n':
+    case 'r':
+    case 't':
+        return 2;
+    case 'u':
+        for (auto p = pos + 2; p != pos + 6 && p != end; ++p)
+        {
+            if (!std::isxdigit(static_cast<unsigned char>(*p)))
+                return 0;
         }
-        break;
-    case e_Expect::StringOrClose:
-        if (token.type != e_Token::String &&
-            token.type != e_Token::RightBrace &&
-            token.type != e_Token::RightBracket)
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+/*
+  Check a string body from pos. Returns its closing quote, or the first error
+  with message set, or end if the body runs out first. With complete, end is
+  the end of the body and nothing may be cut by it. Otherwise an escape or a
+  UTF-8 sequence cut by end may go on in the next chunk, and also gives end.
+*/
+static const char* check_string(const char* pos, const char* end, bool complete, bool validate_utf8,
+                                bool& escaped, const char*& message)
+{
+    while ((pos = validate_utf8 ? impl::find_string_special_utf8(pos, end, escaped)
+                                : impl::find_string_special(pos, end)) != end)
+    {
+        const unsigned char c = *pos;
+        if (c == '"')
+            return pos;
+
+        if (c == '\\')
         {
-            throw Error(token.value.start,
-                        s_parse_errors[enum_value(e_ParseError::ExpectedStringOrCloseObject)]);
+            auto length = escape_length(pos, end);
+            if (!length || (complete && length > static_cast<std::size_t>(end - pos)))
+            {
+                message = s_lexer_errors[enum_value(e_LexerError::BadEscape)];
+                return pos;
+            }
+            if (length > static_cast<std::size_t>(end - pos))
+                return end;
+
+            escaped = true;
+            pos += length;
         }
-        break;
-    case e_Expect::String:
-        if (token.type != e_Token::String)
+        else if (c >= 0x80)
         {
-            throw Error(token.value.start,
-                        s_parse_errors[enum_value(e_ParseError::ExpectedString)]);
+            //a string that doesn't close in this chunk is checked again once it is spliced
+            if (!complete && impl::find_string_special(pos, end) == end)
+                return end;
+
+            message = s_lexer_errors[enum_value(e_LexerError::InvalidUtf8)];
+            return pos;
         }
-        break;
-    case e_Expect::Colon:
-        if (token.type != e_Token::Colon)
-            throw Error(token.value.start, s_parse_errors[enum_value(e_ParseError::ExpectedColon)]);
-        break;
-    case e_Expect::EndOfInput:
-        if (token.type != e_Token::EndOfInput)
+        else
         {
-            throw Error(token.value.start,
-                        s_parse_errors[enum_value(e_ParseError::ExpectedEndOfInput)]);
+            message = s_lexer_errors[enum_value(e_LexerError::ControlCharacter)];
+            return pos;
         }
-        break;
     }
+
+    return end;
 }
 
-void Parser::push(const Lexer::Token& token)
+Lexer::Token Lexer::read_string()
 {
-    check_expect(token);
+    auto start = m_pos;
 
-    switch (token.type)
+    //short strings usually close inside the block that was already classified,
+    //with nothing in them that needs a closer look
+    if (m_block.covers(m_pos))
     {
-    case e_Token::LeftBrace:
-        m_stack.emplace_front(Object(), m_context, m_length);
-        m_context = e_Context::Object;
-        m_expect = e_Expect::StringOrClose;
-        m_length = 0;
-        break;
-    case e_Token::LeftBracket:
-        m_stack.emplace_front(Array(), m_context, m_length);
-        m_context = e_Context::Array;
-        m_expect = e_Expect::ValueOrClose;
-        m_length = 0;
-        break;
-    case e_Token::String:
-        if (m_context == e_Context::Object)
+        const auto offset = m_pos - m_block.base;
+        auto quotes = m_block.quote >> offset;
+        if (quotes)
         {
-            if (m_expect == e_Expect::Value)
-                m_expect = e_Expect::CommaOrClose;
-            else if (m_expect == e_Expect::String || m_expect == e_Expect::StringOrClose)
-                m_expect = e_Expect::Colon;
+            const auto length = impl::count_trailing_zeros(quotes);
+            const auto inside = (std::uint64_t(1) << length) - 1;
+            auto special = ((m_block.backslash | m_block.control) >> offset) & inside;
+            //bytes above ASCII need a look too when validating, the block is checked once for every string in it
+            if (m_validate_utf8 && ((m_block.high >> offset) & inside))
+                special |= (impl::utf8_error_mask(m_block) >> offset) & (inside << 1 | 1);
+            if (!special)
+            {
+                m_pos += length;
+                return Token(e_Token::String, start, m_pos++);
+            }
         }
-        else if (m_context == e_Context::Array)
-            m_expect = e_Expect::CommaOrClose;
-
-        m_stack.emplace_front(String(token.value.start, token.value.end), m_context, m_length);
-        m_length++;
-        break;
-    case e_Token::Integer:
-        m_stack.emplace_front(parse_integer(token), m_context, m_length);
-        m_expect = e_Expect::CommaOrClose;
-        m_length++;
-        break;
-    case e_Token::Float:
-        m_stack.emplace_front(parse_float(token), m_context, m_length);
-        m_expect = e_Expect::CommaOrClose;
-        m_length++;
-        break;
-    case e_Token::True:
-        m_stack.emplace_front(Value(true), m_context, m_length);
-        m_expect = e_Expect::CommaOrClose;
-        m_length++;
-        break;
-    case e_Token::False:
-        m_stack.emplace_front(Value(false), m_context, m_length);
-        m_expect = e_Expect::CommaOrClose;
-        m_length++;
-        break;
-    case e_Token::Null:
-        m_stack.emplace_front(Value(), m_context, m_length);
-        m_expect = e_Expect::CommaOrClose;
-        m_length++;
-        break;
-    default:
-        throw Error(token.value.start, nullptr);
     }
-}
 
-void Parser::pop(const Lexer::Token& token)
-{
-    check_expect(token);
+    bool escaped = false;
+    const char* message = nullptr;
+    auto pos = check_string(start, m_end, false, m_validate_utf8, escaped, message);
+    if (message)
+        return Token(pos, message);
+
+    if (pos != m_end)
+    {
+        m_pos = pos + 1;
+        return Token(e_Token::String, start, pos, escaped);
+    }
 
-    if (token.type == e_Token::RightBracket)
-        pop_until_array(token);
-    else if (token.type == e_Token::RightBrace)
-        pop_until_object(token);
+    if (!m_last)
+        return suspend(e_Token::String, start);
 
-    if (m_context != e_Context::None)
-        m_expect = e_Expect::CommaOrClose;
-    else
-        m_expect = e_Expect::EndOfInput;
+    return Token(start, s_lexer_errors[enum_value(e_LexerError::UnterminatedString)]);
 }
 
-void Parser::pop_until_object(const Lexer::Token& token)
+/*
+  Check a string put together from several chunks, text is everything up to
+  its closing quote or up to and including a control character.
+*/
+static Lexer::Token check_spliced_string(const Lexer::TokenValue& text, bool validate_utf8)
 {
-    auto start = m_stack.begin();
-    auto it = start + m_length;
-
-    if (start != it)
-    {
-        auto& object = it->value.get<e_JsonType::Object>();
-        object.move_assign(start, it,
-                           [](stack_state& v) -> Value&& {
-                               return std::move(v.value);
-                           });
-        m_stack.erase(start, it);
-    }
+    bool escaped = false;
+    const char* message = nullptr;
+    auto pos = check_string(text.start, text.end, true, validate_utf8, escaped, message);
+    if (message)
+        return Lexer::Token(pos, message);
 
-    m_context = it->context;
-    m_length = it->length + 1;
+    return Lexer::Token(e_Token::String, text.start, text.end, escaped);
 }
 
-namespace impl
+//every character a number can contain, the Reader checks the order
+static inline bool number_char(char c)
 {
+    return std::isdigit(c) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-';
+}
 
-template <typename InputIter, typename OutputIter, typename UnaryOp>
-static inline OutputIter move_transform(InputIter start, InputIter end, OutputIter out, UnaryOp op)
+static inline const char* number_end(const char* pos, const char* end)
 {
-    using value_type = typename OutputIter::value_type;
-    while (start != end)
-        *out++ = std::forward<value_type>(op(*start++));
-    return out;
+    while (pos != end && number_char(*pos))
+        ++pos;
+    return pos;
 }
 
-} //impl
-
-void Parser::pop_until_array(const Lexer::Token& token)
+static inline Lexer::Token number_token(const char* start, const char* end)
 {
-    auto start = m_stack.begin();
-    auto it = start + m_length;
-
-    using reverse_iter_type = std::reverse_iterator<decltype(it)>;
-
-    if (start != it)
-    {
-        auto& array = it->value.get<e_JsonType::Array>();
-        array.resize(std::distance(start, it));
+    auto fraction = std::find_if(start, end, [](char c) { return c == '.' || c == 'e' || c == 'E'; });
+    if (fraction == end)
+        return Lexer::Token(e_Token::Integer, start, end);
 
-        reverse_iter_type rstart{ start };
-        reverse_iter_type rit{ it };
+    if (*start == '-' && fraction == start + 1)
+        return Lexer::Token(start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
 
-        impl::move_transform(rit, rstart, array.begin(),
-                             [](stack_state& v) -> Value&& {
-                                 return std::move(v.value);
-                             });
-
-        m_stack.erase(start, it);
-    }
-
-    m_context = it->context;
-    m_length = it->length + 1;
+    return Lexer::Token(e_Token::Float, start, end);
 }
 
-void Parser::comma_colon(const Lexer::Token& token)
+Lexer::Token Lexer::read_number()
 {
-    check_expect(token);
+    auto start = m_pos - 1;
+    m_pos = number_end(m_pos, m_end);
+    if (m_pos != m_end)
+        return number_token(start, m_pos);
 
-    if (m_context == e_Context::Object && token.type == e_Token::Comma)
-        m_expect = e_Expect::String;
-    else
-        m_expect = e_Expect::Value;
+    if (!m_last)
+        return suspend(e_Token::Integer, start);
+
+    return Token(start, s_lexer_errors[enum_value(e_LexerError::UnexpectedEnd)]);
 }
 
-void Parser::error(const Lexer::Token& token)
+struct literal
 {
-    switch (token.type)
-    {
-    case e_Token::Error:
-        throw Error(token.error.pos, token.error.message);
-    case e_Token::EndOfInput:
-        {
-            const char* emsg_ptr = nullptr;
-            if (m_context == e_Context::Object)
-                emsg_ptr = s_parse_errors[enum_value(e_ParseError::UnclosedObject)];
-            else if (m_context == e_Context::Array)
-                emsg_ptr = s_parse_errors[enum_value(e_ParseError::UnclosedArray)];
-            throw Error(token.value.start, emsg_ptr);
-        }
-    default:
-        throw Error(token.value.start, nullptr);
-    }
-}
+    const char* text;
+    std::size_t length;
+    e_LexerError error;
+};
 
-long long Parser::parse_integer(const Lexer::Token& token)
+static inline literal literal_for(e_Token type)
 {
-    //leading zero
-    if (std::distance(token.value.start, token.value.end) > 1 && *token.value.start == '0')
-        throw Error(token.value.start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
-    
-    char* endptr = nullptr;
-    long long result = strtoll(token.value.start, &endptr, 10);
-    if (endptr != token.value.end)
-        throw Error(token.value.start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
-
-    if (errno == ERANGE)
+    switch (type)
     {
-        const char* emsg_ptr = nullptr;
-        if (result == LLONG_MIN)
-            emsg_ptr = s_parse_errors[enum_value(e_ParseError::IntegerUnderflow)];
-        else if (result == LLONG_MAX)
-            emsg_ptr = s_parse_errors[enum_value(e_ParseError::IntegerOverflow)];
-        throw Error(token.value.start, emsg_ptr);
+    case e_Token::True:  return literal{"true", 4, e_LexerError::ExpectedTrue};
+    case e_Token::False: return literal{"false", 5, e_LexerError::ExpectedFalse};
+    default:             return literal{"null", 4, e_LexerError::ExpectedNull};
     }
-
-    return result;
 }
 
-double Parser::parse_float(const Lexer::Token& token)
+Lexer::Token Lexer::read_literal(e_Token type)
 {
-    char* endptr = nullptr;
-    double result = strtod(token.value.start, &endptr);
-    if (endptr != token.value.end)
-        throw Error(token.value.start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
+    const auto word = literal_for(type);
+    auto start = m_pos - 1;
 
-    if (errno == ERANGE)
+    for (std::size_t matched = 1; matched != word.length; ++matched, ++m_pos)
     {
-        const char* emsg_ptr = nullptr;
-        if (result == HUGE_VAL || result == -HUGE_VAL)
-            emsg_ptr = s_parse_errors[enum_value(e_ParseError::FloatingPointOverflow)];
-        else if (result == 0)
-            emsg_ptr = s_parse_errors[enum_value(e_ParseError::FloatingPointUnderflow)];
+        if (m_pos == m_end && !m_last)
+            return suspend(type, start);
 
-        throw Error(token.value.start, emsg_ptr);
+        if (m_pos == m_end || *m_pos != word.text[matched])
+            return Token(start, s_lexer_errors[enum_value(word.error)]);
     }
 
-    return result;
+    return Token(type, start, m_pos);
 }
 
-Value Parser::done(const Lexer::Token& token)
+Lexer::Token Lexer::suspend(e_Token type, const char* start)
 {
-    if (token.type != e_Token::EndOfInput)
-    {
-        throw Error(token.value.start,
-                    s_parse_errors[enum_value(e_ParseError::ExpectedEndOfInput)]);
-    }
+    m_partial = type;
+    m_carry.assign(start, m_end);
+    m_pos = m_end;
 
-    if (m_stack.size() != 1)
+    return Token(e_Token::NeedInput, nullptr, nullptr);
+}
+
+Lexer::TokenValue Lexer::splice()
+{
+    if (!m_splices)
     {
-        throw Error(token.value.start,
-                    s_parse_errors[enum_value(e_ParseError::ExpectedEndOfInput)]);
+        m_own_splices.reset(new impl::arena);
+        m_splices = m_own_splices.get();
     }
 
-    auto start = m_stack.begin();
-    Value result(std::move(start->value));
-    m_stack.pop_front();
+    auto text = static_cast<char*>(m_splices->allocate(m_carry.size() + 1, 1));
+    std::memcpy(text, m_carry.data(), m_carry.size());
 
+    TokenValue result{ text, text + m_carry.size() };
+    m_carry.clear();
+    m_partial = e_Token::EndOfInput;
     return result;
 }
 
-
-void write(std::ostream& o, const Value& val)
+Lexer::Token Lexer::resume()
 {
-    switch (val.type())
+    const auto type = m_partial;
+    const char* stop = m_end;
+    bool complete = false;
+    bool closed = true;
+
+    switch (type)
     {
-    case e_JsonType::Object:
-        impl::write<0>(o, val.get<e_JsonType::Object>());
+    case e_Token::String:
+        {
+            //a backslash at the end of the last chunk escapes the first byte of this one
+            std::size_t backslashes = 0;
+            while (backslashes < m_carry.size() && m_carry[m_carry.size() - 1 - backslashes] == '\\')
+                ++backslashes;
+
+            stop = m_pos;
+            if (stop != m_end && backslashes % 2)
+                ++stop;
+            while ((stop = impl::find_string_special(stop, m_end)) != m_end && *stop == '\\')
+                stop = m_end - stop > 2 ? stop + 2 : m_end;
+
+            complete = stop != m_end;
+
+            //a control character is kept for check_spliced_string to report
+            if (complete && *stop != '"')
+            {
+                closed = false;
+                ++stop;
+            }
+        }
         break;
-    case e_JsonType::Array:
-        impl::write<0>(o, val.get<e_JsonType::Array>());
+
+    case e_Token::Integer:
+        stop = number_end(m_pos, m_end);
+        complete = stop != m_end;
         break;
+
     default:
-        impl::write_simple_value(o, val);
+        {
+            //only the bytes still missing from the literal are consumed
+            const auto word = literal_for(type);
+            stop = m_pos + std::min<std::size_t>(word.length - m_carry.size(), m_end - m_pos);
+            complete = m_carry.size() + (stop - m_pos) == word.length ||
+                       !std::equal(m_pos, stop, word.text + m_carry.size());
+        }
         break;
     }
-    
+
+    m_carry.append(m_pos, stop);
+    m_pos = stop;
+
+    if (!complete && !m_last)
+        return Token(e_Token::NeedInput, nullptr, nullptr);
+
+    auto text = splice();
+    switch (type)
+    {
+    case e_Token::String:
+        if (!complete)
+            return Token(text.start, s_lexer_errors[enum_value(e_LexerError::UnterminatedString)]);
+        if (closed)
+            ++m_pos;
+        return check_spliced_string(text, m_validate_utf8);
+
+    case e_Token::Integer:
+        if (!complete)
+            return Token(text.start, s_lexer_errors[enum_value(e_LexerError::UnexpectedEnd)]);
+        return number_token(text.start, text.end);
+
+    default:
+        {
+            const auto word = literal_for(type);
+            if (static_cast<std::size_t>(text.end - text.start) == word.length &&
+                std::equal(text.start, text.end, word.text))
+            {
+                return Token(type, text.start, text.end);
+            }
+            return Token(text.start, s_lexer_errors[enum_value(word.error)]);
+        }
+    }
+}
+
+enum class e_ParseError : uint8_t
+{
+    UnclosedObject = 0,
+    UnclosedArray,
+    TopLevelNotObjectOrArray,
+    ExpectedString,
+    ExpectedStringOrCloseObject,
+    ExpectedColon,
+    ExpectedCommaOrCloseObject,
+    ExpectedCommaOrCloseArray,
+    ExpectedValue,
+    ExpectedEndOfInput,
+    IntegerOverflow,
+    IntegerUnderflow,
+    FloatingPointOverflow,
+    FloatingPointUnderflow,
+    StoppedByHandler,
+    Count
+};
+
+static const char* s_parse_errors[enum_value(e_ParseError::Count)] =
+{
+    "Unclosed Object",
+    "Unclosed Array",
+    "Top level must be an Object or an Array",
+    "Expected string",
+    "Expected string or '}'",
+    "Expected ':'",
+    "Expected ',' or '}'",
+    "Expected ',' or ']'",
+    "Expected object, array, string, number, true, false, or null",
+    "Expected end of input",
+    "Integer overflow",
+    "Integer underflow",
+    "Floating point overflow",
+    "Floating point underflow",
+    "Stopped by handler"
+};
+
+/*
+  Reader states. m_expect says what may come next, the innermost open
+  container is at the back of m_contexts.
+
+  m_expect      | token          | action
+  ------------------------------------------------------------
+  Root          | { [            | open container
+  Value         | any value      | open container or emit the scalar
+  ValueOrClose  | any value, ]   | as Value, or close the array
+  CommaOrClose  | ,              | expect String in objects, Value in arrays
+  CommaOrClose  | } or ]         | close the innermost container if it matches
+  StringOrClose | String, }      | emit a key, or close the object
+  String        | String         | emit a key
+  Colon         | :              | expect Value
+  EndOfInput    | end of input   | Done
+
+  Anything else is an error. End of input while a container is open reports
+  which kind of container was left unclosed.
+*/
+
+Reader::Reader(const char* start, const char* end)
+    : m_lexer(start, end),
+      m_expect(e_Expect::Root),
+      m_open_end(false),
+      m_lazy_depth(SIZE_MAX),
+      m_string(nullptr, nullptr),
+      m_integer(0),
+      m_floating_point(0)
+{
+}
+
+Reader::Reader(const std::string& input) : Reader(input.data(), input.data() + input.length())
+{
+}
+
+Reader::Reader(impl::arena* splices)
+    : m_lexer(splices),
+      m_expect(e_Expect::Root),
+      m_open_end(false),
+      m_lazy_depth(SIZE_MAX),
+      m_string(nullptr, nullptr),
+      m_integer(0),
+      m_floating_point(0)
+{
+}
+
+void Reader::reset(const char* start, const char* end)
+{
+    const bool validate = m_lexer.validates_utf8();
+    m_lexer = Lexer(start, end);
+    m_lexer.validate_utf8(validate);
+    m_expect = e_Expect::Root;
+    m_open_end = false;
+    m_lazy_depth = SIZE_MAX;
+    m_contexts.clear();
+}
+
+void Reader::reset_elements(const char* start, const char* end, bool last)
+{
+    const bool validate = m_lexer.validates_utf8();
+    m_lexer = Lexer(start, end);
+    m_lexer.validate_utf8(validate);
+    m_expect = e_Expect::Elements;
+    m_open_end = !last;
+    m_lazy_depth = SIZE_MAX;
+    m_contexts.clear();
+}
+
+void Reader::reset(impl::arena* splices)
+{
+    const bool validate = m_lexer.validates_utf8();
+    m_lexer = Lexer(splices);
+    m_lexer.validate_utf8(validate);
+    m_expect = e_Expect::Root;
+    m_open_end = false;
+    m_lazy_depth = SIZE_MAX;
+    m_contexts.clear();
+}
+
+static inline const char* parse_error(e_ParseError e) { return s_parse_errors[enum_value(e)]; }
+
+e_Event Reader::next()
+{
+    switch (m_expect)
+    {
+    case e_Expect::Done:   return e_Event::EndOfInput;
+    case e_Expect::Failed: return e_Event::Error;
+    case e_Expect::Elements:
+        //the '[' itself is not part of the input
+        m_contexts.push_back(e_Context::Array);
+        m_expect = e_Expect::Value;
+        return e_Event::StartArray;
+    default:
+        break;
+    }
+
+    m_token = m_lexer.next();
+    const auto type = m_token.type;
+    const auto pos = m_token.value.start;
+
+    //the state is untouched so the next chunk continues where this one stopped
+    if (type == e_Token::NeedInput)
+        return e_Event::NeedInput;
+
+    if (type == e_Token::Error)
+        return fail(m_token.error.pos, m_token.error.message);
+
+    if (type == e_Token::EndOfInput && !m_contexts.empty())
+    {
+        //the ',' ending a run of elements stands in for the ']'
+        if (m_open_end && m_contexts.size() == 1 && m_expect == e_Expect::Value)
+        {
+            m_contexts.pop_back();
+            m_expect = e_Expect::Done;
+            return e_Event::EndArray;
+        }
+
+        return fail(pos, parse_error(m_contexts.back() == e_Context::Object ? e_ParseError::UnclosedObject
+                                                                            : e_ParseError::UnclosedArray));
+    }
+
+    switch (m_expect)
+    {
+    case e_Expect::Root:
+        if (type == e_Token::LeftBrace || type == e_Token::LeftBracket)
+            return value();
+        return fail(pos, parse_error(e_ParseError::TopLevelNotObjectOrArray));
+
+    case e_Expect::ValueOrClose:
+        if (type == e_Token::RightBracket)
+            return close(e_Context::Array);
+        return value();
+
+    case e_Expect::Value:
+        return value();
+
+    case e_Expect::CommaOrClose:
+        {
+            const auto context = m_contexts.back();
+            if (type == e_Token::Comma)
+            {
+                m_expect = context == e_Context::Object ? e_Expect::String : e_Expect::Value;
+                return next();
+            }
+            if (type == e_Token::RightBrace && context == e_Context::Object)
+                return close(context);
+            if (type == e_Token::RightBracket && context == e_Context::Array)
+                return close(context);
+
+            return fail(pos, parse_error(context == e_Context::Object ? e_ParseError::ExpectedCommaOrCloseObject
+                                                                      : e_ParseError::ExpectedCommaOrCloseArray));
+        }
+
+    case e_Expect::StringOrClose:
+        if (type == e_Token::RightBrace)
+            return close(e_Context::Object);
+        if (type != e_Token::String)
+            return fail(pos, parse_error(e_ParseError::ExpectedStringOrCloseObject));
+        m_string = String(m_token.value.start, m_token.value.end, m_token.escaped);
+        m_expect = e_Expect::Colon;
+        return e_Event::Key;
+
+    case e_Expect::String:
+        if (type != e_Token::String)
+            return fail(pos, parse_error(e_ParseError::ExpectedString));
+        m_string = String(m_token.value.start, m_token.value.end, m_token.escaped);
+        m_expect = e_Expect::Colon;
+        return e_Event::Key;
+
+    case e_Expect::Colon:
+        if (type != e_Token::Colon)
+            return fail(pos, parse_error(e_ParseError::ExpectedColon));
+        m_expect = e_Expect::Value;
+        return next();
+
+    case e_Expect::EndOfInput:
+        if (type != e_Token::EndOfInput)
+            return fail(pos, parse_error(e_ParseError::ExpectedEndOfInput));
+        m_expect = e_Expect::Done;
+        return e_Event::EndOfInput;
+
+    default:
+        return fail(pos, nullptr);
+    }
+}
+
+e_Event Reader::value()
+{
+    switch (m_token.type)
+    {
+    case e_Token::LeftBrace:
+        if (m_contexts.size() >= m_lazy_depth)
+            return skip(e_Context::Object);
+        return open(e_Context::Object);
+    case e_Token::LeftBracket:
+        if (m_contexts.size() >= m_lazy_depth)
+            return skip(e_Context::Array);
+        return open(e_Context::Array);
+    case e_Token::String:
+        m_string = String(m_token.value.start, m_token.value.end, m_token.escaped);
+        return after_value(e_Event::String);
+    case e_Token::Integer:
+        if (!parse_integer(m_token, m_integer))
+            return e_Event::Error;
+        return after_value(e_Event::Integer);
+    case e_Token::Float:
+        if (!parse_float(m_token, m_floating_point))
+            return e_Event::Error;
+        return after_value(e_Event::FloatingPoint);
+    case e_Token::True:
+        return after_value(e_Event::True);
+    case e_Token::False:
+        return after_value(e_Event::False);
+    case e_Token::Null:
+        return after_value(e_Event::Null);
+    default:
+        return fail(m_token.value.start, parse_error(e_ParseError::ExpectedValue));
+    }
+}
+
+e_Event Reader::open(e_Context context)
+{
+    m_contexts.push_back(context);
+    if (context == e_Context::Object)
+    {
+        m_expect = e_Expect::StringOrClose;
+        return e_Event::StartObject;
+    }
+
+    m_expect = e_Expect::ValueOrClose;
+    return e_Event::StartArray;
+}
+
+e_Event Reader::skip(e_Context context)
+{
+    auto start = m_token.value.start;
+    auto end = m_lexer.skip_container();
+    if (!end)
+        return fail(nullptr, parse_error(context == e_Context::Object ? e_ParseError::UnclosedObject
+                                                                      : e_ParseError::UnclosedArray));
+
+    m_string = String(start, end);
+    return after_value(context == e_Context::Object ? e_Event::LazyObject : e_Event::LazyArray);
+}
+
+e_Event Reader::skip()
+{
+    const auto context = m_contexts.back();
+    m_contexts.pop_back();
+    if (skip(context) == e_Event::Error)
+        return e_Event::Error;
+
+    return context == e_Context::Object ? e_Event::EndObject : e_Event::EndArray;
+}
+
+e_Event Reader::close(e_Context context)
+{
+    m_contexts.pop_back();
+    return after_value(context == e_Context::Object ? e_Event::EndObject : e_Event::EndArray);
+}
+
+e_Event Reader::after_value(e_Event event)
+{
+    m_expect = m_contexts.empty() ? e_Expect::EndOfInput : e_Expect::CommaOrClose;
+    return event;
+}
+
+e_Event Reader::fail(const char* pos, const char* message)
+{
+    m_error = Error(pos, message);
+    m_expect = e_Expect::Failed;
+    return e_Event::Error;
+}
+
+bool Reader::fail_value(const char* pos, const char* message)
+{
+    fail(pos, message);
+    return false;
+}
+
+bool Reader::stopped(Error& error)
+{
+    fail(m_token.value.start, parse_error(e_ParseError::StoppedByHandler));
+    error = m_error;
+    return false;
+}
+
+bool Reader::lazy(Parser& parser, e_JsonType type)
+{
+    return parser.lazy(type, m_string);
+}
+
+bool Reader::parse_integer(const Lexer::Token& token, long long& result)
+{
+    //leading zero
+    if (std::distance(token.value.start, token.value.end) > 1 && *token.value.start == '0')
+        return fail_value(token.value.start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
+
+    switch (impl::decode_integer(token.value.start, token.value.end, result))
+    {
+    case impl::e_NumberStatus::Ok:
+        return true;
+    case impl::e_NumberStatus::Overflow:
+        return fail_value(token.value.start, s_parse_errors[enum_value(e_ParseError::IntegerOverflow)]);
+    case impl::e_NumberStatus::Underflow:
+        return fail_value(token.value.start, s_parse_errors[enum_value(e_ParseError::IntegerUnderflow)]);
+    default:
+        return fail_value(token.value.start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
+    }
+}
+
+bool Reader::parse_float(const Lexer::Token& token, double& result)
+{
+    switch (impl::decode_float(token.value.start, token.value.end, result))
+    {
+    case impl::e_NumberStatus::Ok:
+        return true;
+    case impl::e_NumberStatus::Overflow:
+        return fail_value(token.value.start, s_parse_errors[enum_value(e_ParseError::FloatingPointOverflow)]);
+    case impl::e_NumberStatus::Underflow:
+        return fail_value(token.value.start, s_parse_errors[enum_value(e_ParseError::FloatingPointUnderflow)]);
+    default:
+        return fail_value(token.value.start, s_lexer_errors[enum_value(e_LexerError::BadNumber)]);
+    }
+}
+
+
+Parser::Parser(const char* input) : Parser(input, input + strlen(input))
+{
+}
+
+Parser::Parser(const char* start, const char* end)
+    : m_start(start),
+      m_end(end),
+      m_document(nullptr),
+      m_reader(start, end),
+      m_lazy(nullptr)
+{
+}
+
+Parser::Parser(const std::string& input) : Parser(input.data(), input.data() + input.length())
+{
+}
+
+Parser::Parser(Document& document)
+    : m_start(nullptr),
+      m_end(nullptr),
+      m_document(&document),
+      m_lazy(nullptr)
+{
+    start_incremental();
+}
+
+void Parser::reset()
+{
+    if (m_document)
+    {
+        start_incremental();
+        return;
+    }
+
+    m_reader.reset(m_start, m_end);
+    m_values.clear();
+    m_frames.clear();
+}
+
+void Parser::leave_incremental()
+{
+    m_document = nullptr;
+    m_allocator = impl::allocator<Value>();
+}
+
+void Parser::start_incremental()
+{
+    //the tree and any token split between two chunks both live in the document
+    m_document->clear();
+    m_allocator = m_document->get_allocator();
+    m_reader.reset(m_allocator.get_arena());
+    m_values.clear();
+    m_frames.clear();
+}
+
+void Parser::reset(const char* input)
+{
+    leave_incremental();
+    m_start = input;
+    m_end = m_start + strlen(input);
+    reset();
+}
+
+void Parser::reset(const char* start, const char* end)
+{
+    leave_incremental();
+    m_start = start;
+    m_end = end;
+    reset();
+}
+
+void Parser::reset(const std::string& input)
+{
+    leave_incremental();
+    m_start = input.data();
+    m_end = input.data() + input.length();
+    reset();
+}
+
+Value Parser::parse(std::function<void(const Error&)> error_fun)
+{
+    Value result;
+    Error err;
+    if (!parse(result, err))
+        error_fun(err);
+
+    return result;
+}
+
+Value& Parser::parse(Document& document, std::function<void(const Error&)> error_fun)
+{
+    Error err;
+    if (!parse(document, err))
+        error_fun(err);
+
+    return document.root();
+}
+
+bool Parser::parse(Document& document, Error& err)
+{
+    document.clear();
+    return parse(document, document.root(), err);
+}
+
+bool Parser::parse(Document& document, Value& result, Error& err)
+{
+    m_allocator = document.get_allocator();
+    bool ok = parse(result, err);
+    m_allocator = impl::allocator<Value>();
+
+    return ok;
+}
+
+bool Parser::parse(Value& result, Error& err)
+{
+    if (!m_reader.parse(*this, err))
+    {
+        //the partial tree may belong to a Document that is about to be cleared
+        m_values.clear();
+        m_frames.clear();
+        result = Value();
+        return false;
+    }
+
+    //parsed before without a reset, the Reader only has the end of input left
+    if (m_values.empty())
+    {
+        err = Error(m_reader.m_token.value.start, parse_error(e_ParseError::TopLevelNotObjectOrArray));
+        result = Value();
+        return false;
+    }
+
+    result = std::move(m_values.back());
+    m_values.clear();
+    return true;
+}
+
+bool Parser::feed(const char* start, const char* end, Error& err)
+{
+    m_reader.feed(start, end);
+    if (!m_reader.parse(*this, err))
+    {
+        m_values.clear();
+        m_frames.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool Parser::finish(Error& err)
+{
+    m_reader.finish();
+    return parse(m_document->root(), err);
+}
+
+bool Parser::parse_lazy(Document& document, Error& err)
+{
+    document.clear();
+    auto memory = document.m_arena.get();
+    m_lazy = new (memory->allocate(sizeof(impl::lazy_context), alignof(impl::lazy_context)))
+        impl::lazy_context{memory, Error(), m_reader.m_lexer.validates_utf8()};
+    document.m_lazy = m_lazy;
+
+    //only the root is read here, it becomes a single lazy container
+    m_reader.m_lazy_depth = 0;
+    bool ok = parse(document, document.root(), err);
+    m_reader.m_lazy_depth = SIZE_MAX;
+    m_lazy = nullptr;
+
+    return ok;
+}
+
+bool Parser::materialize(impl::lazy_context* context, Value& result, Error& err)
+{
+    m_lazy = context;
+    m_allocator = impl::allocator<Value>(context->memory);
+    m_reader.m_lazy_depth = 1;
+    return parse(result, err);
+}
+
+bool Parser::start_object()
+{
+    m_frames.push_back(m_values.size());
+    return true;
+}
+
+bool Parser::end_object()
+{
+    //the object's keys and values are everything after its frame
+    auto start = m_values.begin() + m_frames.back();
+    auto end = m_values.end();
+    m_frames.pop_back();
+
+    Object object{Object::allocator_type(m_allocator)};
+    object.move_assign(start, end, [](Value& v) -> Value&& { return std::move(v); });
+
+    m_values.erase(start, end);
+    m_values.emplace_back(std::move(object));
+    return true;
+}
+
+bool Parser::start_array()
+{
+    m_frames.push_back(m_values.size());
+    return true;
+}
+
+bool Parser::end_array()
+{
+    auto start = m_values.begin() + m_frames.back();
+    auto end = m_values.end();
+    m_frames.pop_back();
+
+    Array array{m_allocator};
+    array.reserve(std::distance(start, end));
+    for (auto pos = start; pos != end; ++pos)
+        array.push_back(std::move(*pos));
+
+    m_values.erase(start, end);
+    m_values.emplace_back(std::move(array));
+    return true;
+}
+
+bool Parser::key(const String& str)
+{
+    m_values.emplace_back(str);
+    return true;
+}
+
+bool Parser::string(const String& str)
+{
+    m_values.emplace_back(str);
+    return true;
+}
+
+bool Parser::integer(long long i)
+{
+    m_values.emplace_back(i);
+    return true;
+}
+
+bool Parser::floating_point(double d)
+{
+    m_values.emplace_back(d);
+    return true;
+}
+
+bool Parser::boolean(bool b)
+{
+    m_values.emplace_back(b);
+    return true;
+}
+
+bool Parser::null()
+{
+    m_values.emplace_back();
+    return true;
+}
+
+bool Parser::lazy(e_JsonType type, const String& range)
+{
+    auto node = new (m_lazy->memory->allocate(sizeof(impl::lazy_node), alignof(impl::lazy_node)))
+        impl::lazy_node{range.begin(), range.end(), m_lazy};
+    m_values.emplace_back(Value(type, node));
+    return true;
+}
+
+
+bool Parser::parse_elements(const char* start, const char* end, bool last,
+                            Document* document, Value& result, Error& err)
+{
+    m_reader.reset_elements(start, end, last);
+    m_values.clear();
+    m_frames.clear();
+
+    if (document)
+        return parse(*document, result, err);
+    return parse(result, err);
+}
+
+
+NdjsonParser::NdjsonParser(const char* start, const char* end)
+    : m_pos(start),
+      m_end(end),
+      m_line(0),
+      m_next_line(1),
+      m_parser(start, start)
+{
+    skip_blank_lines();
+}
+
+NdjsonParser::NdjsonParser(const std::string& input)
+    : NdjsonParser(input.data(), input.data() + input.length())
+{
+}
+
+void NdjsonParser::reset(const char* start, const char* end, std::size_t first_line)
+{
+    m_pos = start;
+    m_end = end;
+    m_line = 0;
+    m_next_line = first_line;
+    skip_blank_lines();
+}
+
+void NdjsonParser::skip_blank_lines()
+{
+    for (; m_pos != m_end; ++m_pos)
+    {
+        if (*m_pos == '\n')
+            m_next_line++;
+        else if (*m_pos != ' ' && *m_pos != '\t' && *m_pos != '\r')
+            return;
+    }
+}
+
+bool NdjsonParser::next(Document& document, Error& error)
+{
+    document.clear();
+    return next(document, document.root(), error);
+}
+
+bool NdjsonParser::next(Document& document, Value& record, Error& error)
+{
+    auto line_end = static_cast<const char*>(std::memchr(m_pos, '\n', m_end - m_pos));
+    if (!line_end)
+        line_end = m_end;
+
+    m_parser.reset(m_pos, line_end);
+    bool ok = m_parser.parse(document, record, error);
+
+    m_line = m_next_line;
+    m_pos = line_end;
+    skip_blank_lines();
+
+    return ok;
+}
+
+
+namespace impl
+{
+
+const char s_newline_spaces[s_newline_spaces_fill + 2] =
+    "\n"
+    "                                                                "
+    "                                                                ";
+
+output::output(std::string& s)
+    : m_string{&s}
+{
+    const auto used = s.size();
+    s.resize(std::max<std::size_t>(s.capacity(), used + 4096));
+    m_pos = &s[0] + used;
+    m_end = &s[0] + s.size();
+}
+
+output::output(const Sink& sink, std::size_t block_size)
+    : m_sink{&sink},
+      m_block(std::max<std::size_t>(block_size, 256))
+{
+    m_pos = m_block.data();
+    m_end = m_pos + m_block.size();
+}
+
+bool output::make_room(std::size_t n)
+{
+    if (m_string)
+    {
+        const auto used = m_pos - &(*m_string)[0];
+        m_string->resize(std::max(m_string->size() * 2, used + n));
+        m_pos = &(*m_string)[0] + used;
+        m_end = &(*m_string)[0] + m_string->size();
+        return true;
+    }
+
+    if (m_pos != m_block.data())
+        (*m_sink)(m_block.data(), m_pos - m_block.data());
+    m_pos = m_block.data();
+    return n <= m_block.size();
+}
+
+void output::finish()
+{
+    if (m_string)
+    {
+        m_string->resize(m_pos - &(*m_string)[0]);
+        m_end = m_pos;
+        return;
+    }
+
+    if (m_pos != m_block.data())
+        (*m_sink)(m_block.data(), m_pos - m_block.data());
+    m_pos = m_block.data();
+}
+
+} //impl
+
+
+void write(std::ostream& o, const Value& val)
+{
+    impl::write_value(o, val, impl::indenter<0>());
+}
+
+void write(std::string& out, const Value& val)
+{
+    impl::output o{out};
+    impl::write_value(o, val, impl::indenter<0>());
+    o.finish();
+}
+
+void write(const Sink& sink, const Value& val, std::size_t block_size)
+{
+    impl::output o{sink, block_size};
+    impl::write_value(o, val, impl::indenter<0>());
+    o.finish();
+}
+
+void write_pretty(std::ostream& o, const Value& val, const Indent& indent)
+{
+    impl::write_value(o, val, impl::runtime_indenter(indent));
+}
+
+void write_pretty(std::string& out, const Value& val, const Indent& indent)
+{
+    impl::output o{out};
+    impl::write_value(o, val, impl::runtime_indenter(indent));
+    o.finish();
+}
+
+void write_pretty(const Sink& sink, const Value& val, const Indent& indent, std::size_t block_size)
+{
+    impl::output o{sink, block_size};
+    impl::write_value(o, val, impl::runtime_indenter(indent));
+    o.finish();
 }
 
 } //jsonish
@@ -31,49 +31,108 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
-#include <deque>
 #include <functional>
-#include <limits>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <stack>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace jsonish
 {
 
+/*
+  A view of a string in the input. A string with escape sequences keeps its
+  source text, which is decoded only when it is asked for with to_string()
+  or unescape(), so begin(), end() and size() are those of the source text.
+*/
 class String
 {
   public:
-    String(const char* start, const char* end) : m_start(start), m_end(end) { }
+    String(const char* start, const char* end)
+        : m_start(start), m_size(static_cast<std::size_t>(end - start)) { }
+
+    String(const char* start, const char* end, bool escaped)
+        : m_start(start), m_size(static_cast<std::size_t>(end - start) | (escaped ? s_escaped : 0)) { }
 
     template <std::size_t N>
-    String(const char (&str)[N]) : m_start(str), m_end(str + N - 1) { }
+    String(const char (&str)[N]) : m_start(str), m_size(N - 1) { }
 
     bool operator<(const String& rhs) const
     {
-        return std::lexicographical_compare(m_start, m_end, rhs.m_start, rhs.m_end);
+        if (escaped() || rhs.escaped())
+            return to_string() < rhs.to_string();
+        return std::lexicographical_compare(begin(), end(), rhs.begin(), rhs.end());
     }
 
     bool operator<(const char* rhs) const
     {
-        return std::lexicographical_compare(m_start, m_end, rhs, rhs + std::strlen(rhs) + 1);
+        if (escaped())
+            return to_string() < rhs;
+        return std::lexicographical_compare(begin(), end(), rhs, rhs + std::strlen(rhs));
     }
 
     bool operator<(const std::string& rhs) const
     {
-        return std::lexicographical_compare(m_start, m_end, rhs.cbegin(), rhs.cend());
+        if (escaped())
+            return to_string() < rhs;
+        return std::lexicographical_compare(begin(), end(), rhs.cbegin(), rhs.cend());
+    }
+
+    bool operator==(const String& rhs) const
+    {
+        if (rhs.escaped())
+            return rhs == to_string();
+        return equals(rhs.m_start, rhs.size());
+    }
+    bool operator!=(const String& rhs) const { return !(*this == rhs); }
+
+    bool operator==(const std::string& rhs) const { return equals(rhs.data(), rhs.size()); }
+
+    //compares the decoded text with [str, str + length)
+    bool equals(const char* str, std::size_t length) const
+    {
+        if (escaped())
+            return equals_escaped(str, length);
+        return size() == length && std::memcmp(m_start, str, length) == 0;
+    }
+
+    //the decoded text
+    std::string to_string() const
+    {
+        if (!escaped())
+            return std::string(begin(), end());
+
+        std::string result(size(), '\0');
+        result.resize(unescape(&result[0]) - &result[0]);
+        return result;
     }
 
-    std::string to_string() const { return std::string(m_start, m_end); }
+    /*
+      Write the decoded text to out, which needs room for size() characters,
+      and return its end.
+    */
+    char* unescape(char* out) const;
+
+    //true if the text still holds escape sequences
+    bool escaped() const { return (m_size & s_escaped) != 0; }
 
     const char* begin() const { return m_start; }
-    const char* end() const { return m_end; }
+    const char* end() const { return m_start + size(); }
+    std::size_t size() const { return m_size & ~s_escaped; }
     
   private:
+    static const std::size_t s_escaped = ~(~std::size_t(0) >> 1);
+
+    bool equals_escaped(const char* str, std::size_t length) const;
+
     const char* m_start;
-    const char* m_end;
+
+    //the top bit is the escaped flag
+    std::size_t m_size;
 };
 
 
@@ -96,12 +155,128 @@ namespace impl
 template <e_JsonType J>
 struct result_type;
 
+//64 bit FNV-1a
+inline std::uint64_t hash_bytes(const char* str, std::size_t length)
+{
+    std::uint64_t h = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        h ^= static_cast<unsigned char>(str[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline std::uint64_t hash_bytes(const std::string& str) { return hash_bytes(str.data(), str.size()); }
+
+/*
+  A bump allocator. Memory is handed out from large blocks and only released
+  all at once by clear() or the destructor.
+*/
+class arena
+{
+  public:
+    arena();
+    ~arena();
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t alignment)
+    {
+        auto aligned = (reinterpret_cast<std::uintptr_t>(m_pos) + alignment - 1) & ~(alignment - 1);
+        auto pos = reinterpret_cast<char*>(aligned);
+        if (pos + size > m_end || !m_pos)
+            return allocate_slow(size, alignment);
+
+        m_pos = pos + size;
+        return pos;
+    }
+
+    //release everything except the most recent block, which is kept for reuse
+    void clear();
+
+    //bytes held in blocks
+    std::size_t capacity() const;
+
+  private:
+    struct block
+    {
+        block* next;
+        std::size_t size;
+    };
+
+    block* m_blocks;
+    char* m_pos;
+    char* m_end;
+    std::size_t m_next_size;
+
+    void* allocate_slow(std::size_t size, std::size_t alignment);
+};
+
+/*
+  The allocator used by Array and Object. Without an arena it uses the global heap;
+  with one every allocation comes from the arena and deallocation is a no-op.
+  Copies of a container always go back to the heap.
+*/
+template <typename T>
+class allocator
+{
+  public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    allocator() : m_arena(nullptr) { }
+    explicit allocator(arena* a) : m_arena(a) { }
+
+    template <typename U>
+    allocator(const allocator<U>& o) : m_arena(o.get_arena()) { }
+
+    T* allocate(std::size_t n)
+    {
+        if (m_arena)
+            return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t)
+    {
+        if (!m_arena)
+            ::operator delete(p);
+    }
+
+    allocator select_on_container_copy_construction() const { return allocator(); }
+
+    arena* get_arena() const { return m_arena; }
+
+  private:
+    arena* m_arena;
+};
+
+template <typename T, typename U>
+inline bool operator==(const allocator<T>& lhs, const allocator<U>& rhs)
+{ return lhs.get_arena() == rhs.get_arena(); }
+
+template <typename T, typename U>
+inline bool operator!=(const allocator<T>& lhs, const allocator<U>& rhs)
+{ return lhs.get_arena() != rhs.get_arena(); }
+
 } //impl
 
 class Value;
 class Object;
+struct Error;
+class Parser;
+
+namespace impl
+{
+//see Parser::parse_lazy
+struct lazy_node;
+struct lazy_context;
+}
 
-typedef std::vector<Value> Array;
+typedef std::vector<Value, impl::allocator<Value>> Array;
 
 
 class Value
@@ -123,9 +298,9 @@ class Value
     Value(bool b);
 
     Value(const Value& o);
-    Value(Value&& o);
+    Value(Value&& o) noexcept;
     Value& operator=(const Value& o);
-    Value& operator=(Value&& o);
+    Value& operator=(Value&& o) noexcept;
 
     ~Value();
 
@@ -141,26 +316,67 @@ class Value
     { return get_impl(unused); }
 
   private:
+    friend class Parser;
+    friend class Document;
+
     e_JsonType m_type;
+
+    //an Object or Array that hasn't been parsed yet, see Parser::parse_lazy
+    bool m_lazy;
     union
     {
         Object* m_object;
         Array* m_array;
+        impl::lazy_node* m_lazy_node;
         String m_string;
         long long m_integer;
         double m_floating_point;
     };
 
+    Value(e_JsonType type, impl::lazy_node* node);
+
     void copy_guts(const Value& o);
-    void move_guts(Value&& o);
-    
+    void move_guts(Value&& o) noexcept;
+    void destroy() noexcept;
+
+    //parse a lazy container's members, leaving its own containers lazy
+    void materialize();
+
+    //delete the heap Objects and Arrays placed in an arena tree, whose own nodes are never destroyed
+    void release_heap_nodes();
+
+    inline Object& get_impl(Object*)
+    {
+        if (m_lazy)
+            materialize();
+        return *m_object;
+    }
+
+    inline const Object& get_impl(const Object*) const
+    {
+        if (m_lazy)
+            const_cast<Value*>(this)->materialize();
+        return *m_object;
+    }
+
+    inline Array& get_impl(Array*)
+    {
+        if (m_lazy)
+            materialize();
+        return *m_array;
+    }
+
+    inline const Array& get_impl(const Array*) const
+    {
+        if (m_lazy)
+            const_cast<Value*>(this)->materialize();
+        return *m_array;
+    }
 
 #define GET_IMPL(t, n)                                          \
     inline t& get_impl(t*) { return n; }                        \
     inline const t& get_impl(const t*) const { return n; }
 
-    GET_IMPL(Object,    *m_object)
-    GET_IMPL(Array,     *m_array)
     GET_IMPL(String,    m_string)
     GET_IMPL(long long, m_integer)
     GET_IMPL(double,    m_floating_point)
@@ -169,66 +385,116 @@ class Value
 };
 
 
+namespace impl
+{
+//the text of an interned Key and its hash
+typedef std::pair<const std::string, std::uint64_t> interned_key;
+
+//the one entry for [str, str + length), added on first use and kept for the life of the program
+const interned_key* intern(const char* str, std::size_t length);
+}
+
+/*
+  A key name for Object lookups, interned so that every Key with the same
+  text shares one copy of it along with its hash. Keys compare by identity.
+*/
+class Key
+{
+  public:
+    explicit Key(const char* str) : m_key(impl::intern(str, std::strlen(str))) { }
+    explicit Key(const std::string& str) : m_key(impl::intern(str.data(), str.size())) { }
+
+    const char* data() const       { return m_key->first.data(); }
+    std::size_t size() const       { return m_key->first.size(); }
+    std::uint64_t hash() const     { return m_key->second; }
+    const std::string& str() const { return m_key->first; }
+
+    bool operator==(const Key& rhs) const { return m_key == rhs.m_key; }
+    bool operator!=(const Key& rhs) const { return m_key != rhs.m_key; }
+
+  private:
+    const impl::interned_key* m_key;
+};
+
+
 class Object
 {
   public:
-    typedef std::map<String, Value>::iterator       iterator;
-    typedef std::map<String, Value>::const_iterator const_iterator;
+    typedef std::pair<String, Value>                value_type;
+    typedef impl::allocator<value_type>             allocator_type;
+    typedef std::vector<value_type, allocator_type> storage_type;
+    typedef storage_type::iterator                  iterator;
+    typedef storage_type::const_iterator            const_iterator;
+
+    //objects with more members than this get a hash index over their keys
+    static const std::size_t index_threshold = 16;
     
     Object() { }
-    Object(std::initializer_list<std::pair<const String, Value>> ilist) : m_pairs(ilist) { }
+    explicit Object(const allocator_type& alloc) : m_pairs(alloc), m_hashes(alloc), m_index(alloc) { }
+    Object(std::initializer_list<std::pair<const String, Value>> ilist);
 
-    ~Object() { }
+    allocator_type get_allocator() const { return m_pairs.get_allocator(); }
 
     template <typename InputIter, typename GetFunc>
     void move_assign(InputIter start, InputIter end, GetFunc f);
 
+    //adds key unless it is already present, like std::map::emplace
+    std::pair<iterator, bool> emplace(const String& key, Value&& value);
+
     Value& operator[](const char* str)
     {
-        return m_pairs[String(str, str + std::strlen(str))];
+        return get_or_insert(String(str, str + std::strlen(str)));
     }
 
     const Value& operator[](const char* str) const
     {
-        String key{str, str + std::strlen(str)};
-        auto pos = m_pairs.find(key);
-        return pos->second;
+        return m_pairs[find_index(str, std::strlen(str))].second;
     }
 
     Value& operator[](const std::string& str)
     {
         auto start = &str[0];
-        return m_pairs[String{start, start + str.length()}];
+        return get_or_insert(String{start, start + str.length()});
     }
 
     const Value& operator[](const std::string& str) const
     {
-        auto start = &str[0];
-        String key{start, start + str.length()};
-        auto pos = m_pairs.find(key);
-        return pos->second;
+        return m_pairs[find_index(str.data(), str.length())].second;
+    }
+
+    const Value& operator[](const Key& key) const
+    {
+        return m_pairs[find_index(key)].second;
     }
 
     iterator find(const char* key)
     {
-        return m_pairs.find(String{key, key + std::strlen(key)});
+        return m_pairs.begin() + find_index(key, std::strlen(key));
     }
 
     iterator find(const std::string& key)
     {
-        auto start = &key[0];
-        return m_pairs.find(String{start, start + key.length()});
+        return m_pairs.begin() + find_index(key.data(), key.length());
     }
 
     const_iterator find(const char* key) const
     {
-        return m_pairs.find(String{key, key + std::strlen(key)});
+        return m_pairs.cbegin() + find_index(key, std::strlen(key));
     }
 
     const_iterator find(const std::string& key) const
     {
-        auto start = &key[0];
-        return m_pairs.find(String{start, start + key.length()});
+        return m_pairs.cbegin() + find_index(key.data(), key.length());
+    }
+
+    iterator find(const Key& key)
+    {
+        return m_pairs.begin() + find_index(key);
+    }
+
+    const_iterator find(const Key& key) const
+    {
+        return m_pairs.cbegin() + find_index(key);
     }
 
     iterator begin()              { return m_pairs.begin(); }
@@ -244,7 +510,32 @@ class Object
     std::size_t size() const      { return m_pairs.size(); }
 
   private:
-    std::map<String, Value> m_pairs;
+    //members in insertion order
+    storage_type m_pairs;
+
+    //the low half of each member's key hash, so most mismatches are rejected without comparing text
+    std::vector<std::uint32_t, impl::allocator<std::uint32_t>> m_hashes;
+
+    //open addressing table of (position in m_pairs + 1), 0 marks an empty slot.
+    //empty until the object grows past index_threshold
+    std::vector<std::uint32_t, impl::allocator<std::uint32_t>> m_index;
+
+    //position of key in m_pairs, or size() when it isn't there
+    std::size_t find_index(const char* key, std::size_t length) const
+    {
+        return find_index(key, length, impl::hash_bytes(key, length));
+    }
+
+    std::size_t find_index(const Key& key) const
+    {
+        return find_index(key.data(), key.size(), key.hash());
+    }
+
+    std::size_t find_index(const char* key, std::size_t length, std::uint64_t hash) const;
+
+    Value& get_or_insert(const String& key);
+    void index_insert(std::size_t position);
+    void rebuild_index();
 };
 
 
@@ -268,19 +559,102 @@ RESULT_IMPL(e_JsonType::FloatingPoint, double);
 template <typename InputIter, typename GetFunc>
 void Object::move_assign(InputIter start, InputIter end, GetFunc f)
 {
-    //iterator expects (value, key)
+    //iterator expects (key, value)
     m_pairs.clear();
+    m_hashes.clear();
+    m_index.clear();
+    m_pairs.reserve(std::distance(start, end) / 2);
+    m_hashes.reserve(m_pairs.capacity());
     
     for (; start != end; ++start)
     {
-        Value first{ std::forward<Value>(f(*start++)) };
-        Value second{ std::forward<Value>(f(*start)) };
+        Value key{ std::forward<Value>(f(*start++)) };
+        Value value{ std::forward<Value>(f(*start)) };
 
-        m_pairs.emplace(second.get<e_JsonType::String>(), first);
+        emplace(key.get<e_JsonType::String>(), std::move(value));
     }
 }
 
 
+namespace impl
+{
+
+//a read only view of a whole file, mapped into memory where the platform allows it
+class mapped_file
+{
+  public:
+    mapped_file() : m_data(nullptr), m_size(0), m_mapped(false) { }
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool open(const char* path);
+
+    const char* begin() const { return m_data; }
+    const char* end() const   { return m_data + m_size; }
+
+  private:
+    const char* m_data;
+    std::size_t m_size;
+    bool m_mapped;
+};
+
+} //impl
+
+
+/*
+  Owns a Value tree whose Objects, Arrays and their elements are all allocated
+  from a single arena. Destroying or clearing a Document releases the whole
+  tree at once, visiting the nodes only to delete heap Objects and Arrays
+  that were moved into it.
+*/
+class Document
+{
+  public:
+    Document();
+    Document(Document&& o);
+    Document& operator=(Document&& o);
+    ~Document();
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    Value& root()             { return m_root; }
+    const Value& root() const { return m_root; }
+
+    //empty containers allocating from this Document
+    Object make_object();
+    Array make_array();
+
+    //drop the tree, keeping some of the memory for the next one
+    void clear();
+
+    //take over other's memory and input so Values built in other can be moved into this tree.
+    //other is left empty
+    void adopt(Document& other);
+
+    impl::allocator<Value> get_allocator() const { return impl::allocator<Value>(m_arena.get()); }
+
+    //the file read by parse_file, empty otherwise
+    String input() const;
+
+    //the first error found in a subtree of a tree read by Parser::parse_lazy
+    //when it was materialized. message is null if there was none
+    Error lazy_error() const;
+
+  private:
+    friend bool parse_file(const char* path, Document& document, Error& error);
+    friend class Parser;
+
+    std::unique_ptr<impl::arena> m_arena;
+    std::vector<std::unique_ptr<impl::arena>> m_adopted;
+    std::vector<std::unique_ptr<impl::mapped_file>> m_files;
+    impl::lazy_context* m_lazy;
+    Value m_root;
+};
+
+
 enum class e_Token : uint8_t
 {
     LeftBrace = 0,
@@ -296,9 +670,50 @@ enum class e_Token : uint8_t
     False,
     Null,
     EndOfInput,
+    NeedInput,
     Error
 };
 
+namespace impl
+{
+
+/*
+  A classified window of up to 64 bytes of input. Bit i of each mask describes base[i].
+  Bytes past the end of the input are classified as whitespace.
+*/
+struct scan_block
+{
+    const char* base;
+    const char* limit;
+    std::uint64_t whitespace;
+    std::uint64_t structural;
+
+    //quotes escaped by a backslash are left out
+    std::uint64_t quote;
+    std::uint64_t backslash;
+
+    //bytes below 0x20, which may not appear in strings
+    std::uint64_t control;
+
+    //bytes of 0x80 and above, only valid in strings and as UTF-8
+    std::uint64_t high;
+
+    //bytes that may not be part of well formed UTF-8, see utf8_error_mask()
+    std::uint64_t utf8_errors;
+    bool utf8_checked;
+
+    //the byte at limit is escaped by a backslash at the end of the block
+    bool escape_carry;
+
+    scan_block()
+        : base(nullptr), limit(nullptr), whitespace(0), structural(0), quote(0), backslash(0),
+          control(0), high(0), utf8_errors(0), utf8_checked(false), escape_carry(false) { }
+
+    bool covers(const char* p) const { return base && p >= base && p < limit; }
+};
+
+} //impl
+
 class Lexer
 {
   public:
@@ -317,39 +732,81 @@ class Lexer
     struct Token
     {     
         e_Token type;
+
+        //a String with escape sequences
+        bool escaped;
+
         union
         {
             TokenValue value;
             TokenError error;
         };
 
-        Token() : type(e_Token::Error), value{ nullptr, nullptr } { }
+        Token() : type(e_Token::Error), escaped(false), value{ nullptr, nullptr } { }
         
-        Token(e_Token t, const char* s, const char* e) : type(t), value{ s, e }
+        Token(e_Token t, const char* s, const char* e, bool esc = false) : type(t), escaped(esc), value{ s, e }
         {
         }
 
-        Token(const char* s, const char* e) : type(e_Token::Error), error{ s, e }
+        Token(const char* s, const char* e) : type(e_Token::Error), escaped(false), error{ s, e }
         {
         }
     };
 
-    Lexer() = delete;
-
     Lexer(const char* start, const char* end);
 
+    /*
+      Incremental lexing. Input arrives in chunks through feed() and the end
+      of a chunk yields e_Token::NeedInput instead of EndOfInput until
+      finish() is called. A token cut by the end of a chunk is suspended and
+      completed by the next chunk. Only such tokens are copied, into splices
+      or into storage owned by the Lexer when that is null.
+    */
+    explicit Lexer(impl::arena* splices = nullptr);
+    void feed(const char* start, const char* end);
+    void finish();
+
     Token next();
+
+    //only valid on complete input
     Token peek();
 
+    /*
+      Skip the rest of a container whose '{' or '[' was the last token by
+      matching brackets outside of strings, without reading any tokens.
+      Returns the position just past the closing bracket, or null if the
+      input ends first. Only valid on complete input.
+    */
+    const char* skip_container();
+
+    //reject strings that aren't well formed UTF-8, off by default
+    void validate_utf8(bool validate) { m_validate_utf8 = validate; }
+    bool validates_utf8() const       { return m_validate_utf8; }
+
   private:
     const char* m_pos;
     const char* m_end;
+    impl::scan_block m_block;
+
+    //false while more chunks may follow m_end
+    bool m_last;
+    bool m_validate_utf8;
 
+    //the kind of the suspended token, EndOfInput if there is none.
+    //numbers are suspended as Integer
+    e_Token m_partial;
+    std::string m_carry;
+    impl::arena* m_splices;
+    std::unique_ptr<impl::arena> m_own_splices;
+
+    void skip_whitespace();
     Token read_string();
     Token read_number();
-    Token read_potential_true();
-    Token read_potential_false();
-    Token read_potential_null();
+    Token read_literal(e_Token type);
+
+    Token suspend(e_Token type, const char* start);
+    Token resume();
+    TokenValue splice();
 };
 
 struct Error
@@ -360,76 +817,453 @@ struct Error
     Error(const char* p, const char* m) : pos(p), message(m) { }
 };
 
-class Parser
+enum class e_Event : uint8_t
 {
-  public:
-    Parser() = delete;
+    StartObject = 0,
+    EndObject,
+    StartArray,
+    EndArray,
+    Key,
+    String,
+    Integer,
+    FloatingPoint,
+    True,
+    False,
+    Null,
+    EndOfInput,
+    NeedInput,
+    Error,
 
-    Parser(const char* input);
-    Parser(const char* start, const char* end);
-    Parser(const std::string& input);
+    //a container skipped by Parser::parse_lazy, string() is its source text
+    LazyObject,
+    LazyArray
+};
+
+namespace impl
+{
+class parallel_parser;
+}
+
+/*
+  A validating pull parser. Each call to next() reads tokens from the Lexer and
+  returns the next event of the document. Apart from one byte per level of
+  nesting a Reader uses constant memory and never allocates a Value.
+*/
+class Reader
+{
+  public:
+    Reader(const char* start, const char* end);
+    explicit Reader(const std::string& input);
 
-    void reset();
-    void reset(const char* input);
     void reset(const char* start, const char* end);
-    void reset(const std::string& input);
 
-    Value parse(std::function<void(const Error&)> error_fun);
+    //incremental reading, see Lexer. next() returns NeedInput at the end of each chunk
+    explicit Reader(impl::arena* splices = nullptr);
+    void reset(impl::arena* splices = nullptr);
+    void feed(const char* start, const char* end) { m_lexer.feed(start, end); }
+    void finish()                                 { m_lexer.finish(); }
+
+    //see Lexer::validate_utf8, kept across reset()
+    void validate_utf8(bool validate)             { m_lexer.validate_utf8(validate); }
+
+    //once Error or EndOfInput is returned every later call returns it again
+    e_Event next();
+
+    /*
+      Skip the container whose StartObject or StartArray was just returned.
+      Only its brackets are matched, its contents are neither read nor
+      checked. Returns its EndObject or EndArray with string() holding its
+      source text, or Error. Only valid on complete input.
+    */
+    e_Event skip();
+
+    //drive handler with every event of the document, see README.txt for the interface.
+    //in incremental mode this also returns true when the current chunk runs out
+    template <typename Handler>
+    bool parse(Handler& handler, Error& error);
+
+    //true once the whole document has been read
+    bool complete() const                 { return m_expect == e_Expect::Done; }
+
+    //the payload of the last event
+    const String& string() const          { return m_string; }
+    long long integer() const             { return m_integer; }
+    double floating_point() const         { return m_floating_point; }
+    const Error& error() const            { return m_error; }
+
+    //the source text of the last event's token
+    const Lexer::Token& token() const     { return m_token; }
+
+    //number of containers currently open
+    std::size_t depth() const             { return m_contexts.size(); }
 
   private:
-    const char* m_start;
-    const char* m_end;
     Lexer m_lexer;
+    Lexer::Token m_token;
 
     enum class e_Expect : uint8_t
     {
-        Value = 0,
+        Root = 0,
+        Value,
         ValueOrClose,
         CommaOrClose,
         StringOrClose,
         String,
         Colon,
-        EndOfInput
+        EndOfInput,
+        Done,
+        Failed,
+        Elements
     };
     e_Expect m_expect;
-    
+
+    //see reset_elements()
+    bool m_open_end;
+
+    //containers opened at this depth or deeper are skipped, see Parser::parse_lazy
+    std::size_t m_lazy_depth;
+
     enum class e_Context : uint8_t
     {
-        None,
         Object,
         Array
     };
-    e_Context m_context;
 
-    unsigned int m_length;
+    //every open container, innermost at the back
+    std::vector<e_Context> m_contexts;
+
+    String m_string;
+    long long m_integer;
+    double m_floating_point;
+    Error m_error;
+
+    e_Event value();
+    e_Event open(e_Context context);
+    e_Event skip(e_Context context);
+    e_Event close(e_Context context);
+    e_Event after_value(e_Event event);
+    e_Event fail(const char* pos, const char* message);
+    bool fail_value(const char* pos, const char* message);
+    bool stopped(Error& error);
+
+    //only a Parser can read lazily
+    template <typename Handler>
+    bool lazy(Handler&, e_JsonType) { return true; }
+    bool lazy(Parser& parser, e_JsonType type);
+
+    bool parse_integer(const Lexer::Token& token, long long& result);
+    bool parse_float(const Lexer::Token& token, double& result);
+
+    /*
+      Read a run of elements of the top level Array as if it were a whole
+      Array. [start, end) begins at an element. Unless last is set it ends
+      just after the ',' that follows the run, which then closes the Array.
+    */
+    friend class Parser;
+    void reset_elements(const char* start, const char* end, bool last);
+};
+
+
+class Parser
+{
+  public:
+    Parser(const char* input);
+    Parser(const char* start, const char* end);
+    Parser(const std::string& input);
+
+    void reset();
+    void reset(const char* input);
+    void reset(const char* start, const char* end);
+    void reset(const std::string& input);
+
+    Value parse(std::function<void(const Error&)> error_fun);
+    Value& parse(Document& document, std::function<void(const Error&)> error_fun);
+
+    //the same as above with the error handler resolved at compile time
+    template <typename ErrorFunc>
+    Value parse(ErrorFunc&& error_fun);
+
+    template <typename ErrorFunc>
+    Value& parse(Document& document, ErrorFunc&& error_fun);
+
+    //report errors through the return value instead of a callback. No exceptions are thrown
+    bool parse(Value& result, Error& error);
+    bool parse(Document& document, Error& error);
+
+    //build result from document's memory without releasing what document already holds
+    bool parse(Document& document, Value& result, Error& error);
+
+    /*
+      Reject strings, keys included, that aren't well formed UTF-8 with an
+      Error at the first bad byte. Off by default, kept across reset().
+      Applies to the containers of parse_lazy as they are parsed.
+    */
+    void validate_utf8(bool validate) { m_reader.validate_utf8(validate); }
+
+    //incremental parsing into document, the input arrives in pieces through feed()
+    explicit Parser(Document& document);
+    bool feed(const char* start, const char* end, Error& error);
+    bool finish(Error& error);
+
+    /*
+      Parse into document on demand. Only the brackets of the input are
+      matched here, its Objects and Arrays are parsed when get() first returns
+      them, and their own Objects and Arrays are left for later in turn. The
+      input must outlive document. Errors inside a container are only found
+      when it is parsed, it is then left empty and document.lazy_error()
+      reports the first of them. Reading a lazy tree modifies it, so it must
+      not be read from several threads at once. Not for incremental parsing.
+    */
+    bool parse_lazy(Document& document, Error& error);
+
+  private:
+    friend class Reader;
+    friend class Value;
+    friend class impl::parallel_parser;
+
+    const char* m_start;
+    const char* m_end;
+    Document* m_document;
+    Reader m_reader;
+    impl::allocator<Value> m_allocator;
+
+    //where lazy containers record their errors, null unless parsing lazily
+    impl::lazy_context* m_lazy;
+
+    //finished values of every open container in document order, keys included.
+    //only ever cleared, so its capacity is reused across reset() and parse()
+    std::vector<Value> m_values;
+
+    //where each open container's values start in m_values
+    std::vector<std::size_t> m_frames;
+
+    //Reader handler interface, builds the tree
+    bool start_object();
+    bool end_object();
+    bool start_array();
+    bool end_array();
+    bool key(const String& str);
+    bool string(const String& str);
+    bool integer(long long i);
+    bool floating_point(double d);
+    bool boolean(bool b);
+    bool null();
+    bool lazy(e_JsonType type, const String& range);
+
+    //parse the members of a lazy container, see Value::materialize
+    bool materialize(impl::lazy_context* context, Value& result, Error& error);
+
+    void start_incremental();
+    void leave_incremental();
+
+    //parse a run of the top level Array's elements into result, see Reader::reset_elements
+    bool parse_elements(const char* start, const char* end, bool last,
+                        Document* document, Value& result, Error& error);
+};
+
 
-    struct stack_state
+template <typename Handler>
+inline bool Reader::parse(Handler& handler, Error& error)
+{
+    while (true)
     {
-        Value value;
-        e_Context context;
-        unsigned int length;
+        bool ok = true;
+        switch (next())
+        {
+        case e_Event::StartObject:   ok = handler.start_object();                 break;
+        case e_Event::EndObject:     ok = handler.end_object();                   break;
+        case e_Event::StartArray:    ok = handler.start_array();                  break;
+        case e_Event::EndArray:      ok = handler.end_array();                    break;
+        case e_Event::Key:           ok = handler.key(m_string);                  break;
+        case e_Event::String:        ok = handler.string(m_string);               break;
+        case e_Event::Integer:       ok = handler.integer(m_integer);             break;
+        case e_Event::FloatingPoint: ok = handler.floating_point(m_floating_point); break;
+        case e_Event::True:          ok = handler.boolean(true);                  break;
+        case e_Event::False:         ok = handler.boolean(false);                 break;
+        case e_Event::Null:          ok = handler.null();                         break;
+        case e_Event::EndOfInput:
+        case e_Event::NeedInput:     return true;
+        case e_Event::Error:
+            error = m_error;
+            return false;
+        case e_Event::LazyObject:    ok = lazy(handler, e_JsonType::Object);      break;
+        case e_Event::LazyArray:     ok = lazy(handler, e_JsonType::Array);       break;
+        }
+
+        if (!ok)
+            return stopped(error);
+    }
+}
+
+
+template <typename ErrorFunc>
+inline Value Parser::parse(ErrorFunc&& error_fun)
+{
+    Value result;
+    Error error;
+    if (!parse(result, error))
+        error_fun(error);
+
+    return result;
+}
+
+template <typename ErrorFunc>
+inline Value& Parser::parse(Document& document, ErrorFunc&& error_fun)
+{
+    Error error;
+    if (!parse(document, error))
+        error_fun(error);
+
+    return document.root();
+}
+
+
+/*
+  Newline delimited JSON (JSON Lines). Each non blank line is one record,
+  parsed with a single Parser whose stacks are reused from record to record.
+  Passing the same Document to every next() reuses its memory as well.
+*/
+class NdjsonParser
+{
+  public:
+    NdjsonParser() = delete;
+
+    NdjsonParser(const char* start, const char* end);
+    explicit NdjsonParser(const std::string& input);
+
+    //start over on new input whose first line is numbered first_line
+    void reset(const char* start, const char* end, std::size_t first_line = 1);
+
+    //true once every record has been read
+    bool done() const               { return m_pos == m_end; }
+
+    //parse the next record into document. An invalid record fills in error
+    //and returns false, the following records are still read
+    bool next(Document& document, Error& error);
 
-        stack_state(Value&& v, e_Context c, unsigned int l) 
-            : value(std::forward<Value>(v)), context(c), length(l) { }
+    //the same, but adds the record to document as record instead of replacing document's root
+    bool next(Document& document, Value& record, Error& error);
+
+    //1 based line number of the record last returned by next()
+    std::size_t line() const        { return m_line; }
+
+    //see Parser::validate_utf8
+    void validate_utf8(bool validate) { m_parser.validate_utf8(validate); }
+
+  private:
+    const char* m_pos;
+    const char* m_end;
+    std::size_t m_line;
+    std::size_t m_next_line;
+    Parser m_parser;
+
+    void skip_blank_lines();
+};
+
+
+/*
+  Parse a document whose top level is an Array on several threads. The
+  elements are found first, then parsed in parallel and moved into the Array.
+  The result, and the error when there is one, are exactly those of Parser.
+  threads == 0 uses every hardware thread.
+*/
+bool parse_parallel(const char* start, const char* end, unsigned int threads, Document& document, Error& error);
+bool parse_parallel(const char* start, const char* end, unsigned int threads, Value& result, Error& error);
+
+
+/*
+  Parse a whole file into document. The file is mapped into memory instead of
+  being read, and document keeps the mapping for as long as it holds the tree,
+  so no copy of the input is ever made. On failure document still holds the
+  input for error.pos to point into, unless the file couldn't be read at all.
+*/
+bool parse_file(const char* path, Document& document, Error& error);
+bool parse_file(const std::string& path, Document& document, Error& error);
+
+
+/*
+  Find the values at a set of JSON Pointers (RFC 6901) without parsing the
+  rest of the document. A "*" reference token matches every member or
+  element. The input is read with a Reader and every value no pointer can
+  reach is skipped by matching brackets, so no Value is built for it and it
+  is not checked. A Query can be run on many inputs.
+*/
+class Query
+{
+  public:
+    explicit Query(const std::vector<std::string>& pointers);
+    Query(std::initializer_list<std::string> pointers);
+
+    /*
+      Call on_match with the index of the pointer and the value for every
+      match, in document order. value is only valid during the call. Stops
+      reading once every pointer without a "*" has matched. Returns false
+      and fills in error for invalid pointers or input.
+    */
+    bool run(const char* start, const char* end,
+             std::function<void(std::size_t pointer, const Value& value)> on_match, Error& error);
+
+  private:
+    struct reference
+    {
+        std::string key;
+        //the array position key names, -1 if it isn't one
+        long long index;
+        bool any;
     };
 
-    std::deque<stack_state> m_stack;
+    std::vector<std::vector<reference>> m_pointers;
+    bool m_valid;
+    bool m_wildcards;
+    Reader m_reader;
+
+    //the pointers that can still match below each open container,
+    //m_live[m_frames[d]...] for the container at depth d
+    std::vector<std::size_t> m_live;
+    std::vector<std::size_t> m_frames;
+    std::vector<long long> m_positions;
+
+    //the pointers that reach the next value
+    std::vector<std::size_t> m_next;
+
+    //pointers whose only possible match has been found, unused with wildcards
+    std::vector<bool> m_done;
+
+    void add(const std::string& pointer);
+    void advance(std::size_t depth, const String* key, long long position);
+    bool found(std::size_t depth, const Value& value,
+               const std::function<void(std::size_t, const Value&)>& on_match, std::size_t& remaining);
+    void resolve(std::size_t pointer, std::size_t depth, const Value& value,
+                 const std::function<void(std::size_t, const Value&)>& on_match);
+};
 
-    unsigned int top_type() const;
-    void check_expect(const Lexer::Token& token) const;
-    void push(const Lexer::Token& token);
-    void pop(const Lexer::Token& token);
-    void pop_until_object(const Lexer::Token& token);
-    void pop_until_array(const Lexer::Token& token);
-    void comma_colon(const Lexer::Token& token);
-    void error(const Lexer::Token& token);
+//run a Query once
+bool extract(const char* start, const char* end, const std::vector<std::string>& pointers,
+             std::function<void(std::size_t pointer, const Value& value)> on_match, Error& error);
+bool extract(const std::string& input, const std::vector<std::string>& pointers,
+             std::function<void(std::size_t pointer, const Value& value)> on_match, Error& error);
 
-    long long parse_integer(const Lexer::Token& token);
-    double parse_float(const Lexer::Token& token);
 
-    Value done(const Lexer::Token& token);
+enum class e_Order : uint8_t
+{
+    InOrder = 0,
+    Unordered
 };
 
+/*
+  Parse newline delimited JSON on several threads. The buffer is cut at line
+  boundaries into chunks that a pool of threads parses, each thread with its
+  own NdjsonParser and Document. threads == 0 uses every hardware thread.
+
+  InOrder makes the calls in line order, one at a time. Unordered makes them
+  from the worker threads as soon as each record is parsed, so they can run
+  concurrently. record is only valid during the call and the callbacks must
+  not throw.
+*/
+void parse_ndjson(const char* start, const char* end, unsigned int threads, e_Order order,
+                  std::function<void(std::size_t line, Value& record)> on_record,
+                  std::function<void(std::size_t line, const Error& error)> on_error);
+
 
 //output
 
@@ -438,6 +1272,51 @@ void write(std::ostream& o, const Value& val);
 template <unsigned int IndentWidth = 4>
 void write_pretty(std::ostream& o, const Value& val);
 
+/*
+  Append val to out, writing straight into the string and growing it as
+  needed rather than going through an ostream.
+*/
+void write(std::string& out, const Value& val);
+
+template <unsigned int IndentWidth = 4>
+void write_pretty(std::string& out, const Value& val);
+
+/*
+  Hand the output to sink in blocks of block_size bytes, and whatever is
+  left at the end. Strings longer than a block are handed over directly
+  from the Value.
+*/
+using Sink = std::function<void(const char* data, std::size_t size)>;
+
+void write(const Sink& sink, const Value& val, std::size_t block_size = 64 * 1024);
+
+template <unsigned int IndentWidth = 4>
+void write_pretty(const Sink& sink, const Value& val, std::size_t block_size = 64 * 1024);
+
+/*
+  Indentation chosen at run time rather than through write_pretty's template
+  parameter: width copies of fill per level, e.g. Indent{1, '\t'}.
+*/
+struct Indent
+{
+    explicit Indent(unsigned int w = 4, char f = ' ') : width(w), fill(f) { }
+    unsigned int width;
+    char fill;
+};
+
+void write_pretty(std::ostream& o, const Value& val, const Indent& indent);
+void write_pretty(std::string& out, const Value& val, const Indent& indent);
+void write_pretty(const Sink& sink, const Value& val, const Indent& indent,
+                  std::size_t block_size = 64 * 1024);
+
+/*
+  Write val compactly to the file descriptor fd with writev. Small pieces
+  are gathered into a block, strings of 256 bytes or more are written
+  straight from where they are, usually the input they were parsed from.
+  Only available on POSIX systems.
+*/
+bool write_fd(int fd, const Value& val, Error& error);
+
 
 namespace impl
 {
@@ -534,74 +1413,302 @@ struct stack_value
 };
 
 
-template <std::size_t N>
-inline void ostream_write(std::ostream& o, const char (&str)[N]) { o.write(str, N - 1); }
+/*
+  Buffered output for the writer, in place of an ostream. It either grows a
+  string and writes straight into it or fills a block and hands every full
+  block to a sink. finish() must be called to hand over the last of it.
+*/
+class output
+{
+public:
+    explicit output(std::string& s);
+    output(const Sink& sink, std::size_t block_size);
 
+    output(const output&) = delete;
+    output& operator=(const output&) = delete;
 
-template <unsigned int IndentWidth>
-struct indenter
+    void put(char c)
+    {
+        if (m_pos == m_end)
+            make_room(1);
+        *m_pos++ = c;
+    }
+
+    void write(const char* s, std::size_t n)
+    {
+        if (static_cast<std::size_t>(m_end - m_pos) < n && !make_room(n))
+        {
+            //larger than a block, handed over as it is
+            (*m_sink)(s, n);
+            return;
+        }
+        std::memcpy(m_pos, s, n);
+        m_pos += n;
+    }
+
+    //room for n characters to be written in place, n is at most 256
+    char* reserve(std::size_t n)
+    {
+        if (static_cast<std::size_t>(m_end - m_pos) < n)
+            make_room(n);
+        return m_pos;
+    }
+
+    void commit(char* end) { m_pos = end; }
+
+    void finish();
+
+private:
+    //false when n can never fit in a block
+    bool make_room(std::size_t n);
+
+    std::string* m_string = nullptr;
+    const Sink* m_sink = nullptr;
+    std::vector<char> m_block;
+    char* m_pos;
+    char* m_end;
+};
+
+
+template <typename Out, std::size_t N>
+inline void write_literal(Out& o, const char (&str)[N]) { o.write(str, N - 1); }
+
+/*
+  Copy the first n of the padded characters at s. Where the output allows,
+  all of them are copied and only n kept, a fixed size copy being much
+  cheaper than a variable one this short.
+*/
+inline void write_padded(std::ostream& o, const char* s, std::size_t n, std::size_t /*padded*/)
+{
+    o.write(s, n);
+}
+
+template <typename Out>
+inline void write_padded(Out& o, const char* s, std::size_t n, std::size_t padded)
+{
+    auto pos = o.reserve(padded);
+    std::memcpy(pos, s, padded);
+    o.commit(pos + n);
+}
+
+/*
+  Indentation is written as a newline and fill characters in one piece,
+  copied from a table, in as many pieces as the table needs for deep levels.
+*/
+template <typename Out>
+inline void newline_indent(Out& o, const char* table, std::size_t table_fill, std::size_t count)
 {
-    static void indent(std::ostream& o, int n)
+    auto n = std::min(count, table_fill);
+    write_padded(o, table, n + 1, table_fill + 1);
+    for (count -= n; count > 0; count -= n)
     {
-        std::fill_n(std::ostream_iterator<char>(o), IndentWidth * n, ' ');
+        n = std::min(count, table_fill);
+        o.write(table + 1, n);
     }
+}
 
-    static void object_open(std::ostream& o) { ostream_write(o, "{\n"); }
-    static void object_close(std::ostream& o, int n) 
+//a newline and s_newline_spaces_fill spaces
+const std::size_t s_newline_spaces_fill = 128;
+extern const char s_newline_spaces[s_newline_spaces_fill + 2];
+
+//the punctuation of pretty output, Derived provides indent()
+template <typename Derived>
+struct pretty_indenter
+{
+    template <typename Out>
+    void object_open(Out& o) const { o.put('{'); }
+    template <typename Out>
+    void object_close(Out& o, int n) const
     {
-        o.put('\n');
-        indent(o, n - 1);
+        static_cast<const Derived&>(*this).indent(o, n - 1);
         o.put('}');
     }
 
-    static void array_open(std::ostream& o) { ostream_write(o, "[\n"); }
-    static void array_close(std::ostream& o, int n)
+    template <typename Out>
+    void array_open(Out& o) const { o.put('['); }
+    template <typename Out>
+    void array_close(Out& o, int n) const
     {
-        o.put('\n');
-        indent(o, n - 1);
+        static_cast<const Derived&>(*this).indent(o, n - 1);
         o.put(']');
     }
 
-    static void comma(std::ostream& o, const stack_value& top)
+    template <typename Out>
+    void comma(Out& o, const stack_value& top) const
     {
         if ((top.is_object() && !top.object_empty() && !top.at_object_end()) ||
             (!top.array_empty() && !top.at_array_end()))
-            ostream_write(o, ",\n");
+            o.put(',');
     }
 
-    static void comma(std::ostream& o)       { ostream_write(o, ",\n"); }
-    static void colon(std::ostream& o)       { ostream_write(o, ": "); }
+    template <typename Out>
+    void comma(Out& o) const  { o.put(','); }
+    template <typename Out>
+    void colon(Out& o) const  { write_literal(o, ": "); }
+};
+
+template <unsigned int IndentWidth>
+struct indenter : pretty_indenter<indenter<IndentWidth>>
+{
+    template <typename Out>
+    void indent(Out& o, int n) const
+    {
+        newline_indent(o, s_newline_spaces, s_newline_spaces_fill, IndentWidth * n);
+    }
 };
 
 template <>
 struct indenter<0>
 {
-    static void indent(std::ostream& o, int n) { }
-    static void object_open(std::ostream& o) { o.put('{'); }
-    static void object_close(std::ostream& o, int n) { o.put('}'); }
-    static void array_open(std::ostream& o) { o.put('['); }
-    static void array_close(std::ostream& o, int n) { o.put(']'); }
-
-    static void comma(std::ostream& o, const stack_value& top)
+    template <typename Out>
+    void indent(Out& o, int n) const { }
+    template <typename Out>
+    void object_open(Out& o) const { o.put('{'); }
+    template <typename Out>
+    void object_close(Out& o, int n) const { o.put('}'); }
+    template <typename Out>
+    void array_open(Out& o) const { o.put('['); }
+    template <typename Out>
+    void array_close(Out& o, int n) const { o.put(']'); }
+
+    template <typename Out>
+    void comma(Out& o, const stack_value& top) const
     {
         if ((top.is_object() && !top.object_empty() && !top.at_object_end()) ||
             (!top.array_empty() && !top.at_array_end()))
             o.put(',');
     }
 
-    static void comma(std::ostream& o) { o.put(','); }
-    static void colon(std::ostream& o) { o.put(':'); }
+    template <typename Out>
+    void comma(Out& o) const { o.put(','); }
+    template <typename Out>
+    void colon(Out& o) const { o.put(':'); }
 };
 
-inline void write_string(std::ostream& o, const String& s)
+//an Indent chosen at run time, with its own table of fill characters
+class runtime_indenter : public pretty_indenter<runtime_indenter>
+{
+  public:
+    explicit runtime_indenter(const Indent& indent)
+        : m_width{indent.width},
+          m_table(1 + s_newline_spaces_fill, indent.fill)
+    {
+        m_table[0] = '\n';
+    }
+
+    template <typename Out>
+    void indent(Out& o, int n) const
+    {
+        newline_indent(o, m_table.data(), s_newline_spaces_fill, m_width * n);
+    }
+
+  private:
+    std::size_t m_width;
+    std::vector<char> m_table;
+};
+
+/*
+  Write the shortest digits that read back as value into buffer, which needs
+  room for 32 characters, and return the end. There is always a '.' or an
+  exponent so the number reads back as a FloatingPoint. Infinities and NaN
+  have no JSON form and are written as null.
+*/
+char* format_double(char* buffer, double value);
+
+//write value in decimal into buffer, which needs room for 20 characters, and return the end
+char* format_integer(char* buffer, long long value);
+
+//numbers are formatted on the stack for an ostream, in place for anything else
+template <typename T>
+inline void write_number(std::ostream& o, char* (*format)(char*, T), T value)
+{
+    char buf[32];
+    auto end = format(buf, value);
+    o.write(buf, end - buf);
+}
+
+template <typename Out, typename T>
+inline void write_number(Out& o, char* (*format)(char*, T), T value)
+{
+    o.commit(format(o.reserve(32), value));
+}
+
+//'"', '\\' and control characters in [start, min(start + 64, end)), see jsonish_simd.hpp
+std::uint64_t string_special_mask(const char* start, const char* end);
+
+inline unsigned int count_trailing_zeros(std::uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    unsigned int n = 0;
+    while (!(x & 1))
+    {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+
+//a character that can't appear in a JSON string as it is
+template <typename Out>
+inline void write_escape(Out& o, unsigned char c)
+{
+    switch (c)
+    {
+    case '"':  write_literal(o, "\\\""); break;
+    case '\\': write_literal(o, "\\\\"); break;
+    case '\b': write_literal(o, "\\b");  break;
+    case '\f': write_literal(o, "\\f");  break;
+    case '\n': write_literal(o, "\\n");  break;
+    case '\r': write_literal(o, "\\r");  break;
+    case '\t': write_literal(o, "\\t");  break;
+    default:
+        {
+            static const char hex[] = "0123456789abcdef";
+            const char sequence[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            o.write(sequence, sizeof(sequence));
+        }
+        break;
+    }
+}
+
+/*
+  A String parsed from escaped text still holds its escapes and is written
+  as it is. Any other String holds the characters themselves. They are
+  looked at 64 at a time, and runs that need no escaping are copied whole.
+*/
+template <typename Out>
+inline void write_string(Out& o, const String& s)
 {
     o.put('"');
-    auto len = std::distance(s.begin(), s.end());
-    o.write(s.begin(), len);
+    if (s.escaped())
+    {
+        o.write(s.begin(), s.size());
+    }
+    else
+    {
+        auto pos = s.begin();
+        const auto end = s.end();
+        for (auto block = pos; block < end; block += 64)
+        {
+            for (auto bits = string_special_mask(block, end); bits; bits &= bits - 1)
+            {
+                const auto special = block + count_trailing_zeros(bits);
+                o.write(pos, special - pos);
+                write_escape(o, *special);
+                pos = special + 1;
+            }
+        }
+        o.write(pos, end - pos);
+    }
     o.put('"');
 }
 
-inline void write_simple_value(std::ostream& o, const Value& v)
+template <typename Out>
+inline void write_simple_value(Out& o, const Value& v)
 {
     switch (v.type())
     {
@@ -611,33 +1718,26 @@ inline void write_simple_value(std::ostream& o, const Value& v)
         write_string(o, v.get<e_JsonType::String>());
         break;
     case e_JsonType::Integer:
-        o << v.get<e_JsonType::Integer>();
+        write_number(o, format_integer, v.get<e_JsonType::Integer>());
         break;
     case e_JsonType::FloatingPoint:
-        {
-            char buf[std::numeric_limits<double>::max_digits10 + 1];
-            double d = v.get<e_JsonType::FloatingPoint>();
-            std::snprintf(buf, std::numeric_limits<double>::max_digits10 + 1, "%f", d);
-            o << buf;
+        write_number(o, format_double, v.get<e_JsonType::FloatingPoint>());
         break;
-        }
     case e_JsonType::True:
-        ostream_write(o, "true");
+        write_literal(o, "true");
         break;
     case e_JsonType::False:
-        ostream_write(o, "false");
+        write_literal(o, "false");
         break;
     case e_JsonType::Null:
-        ostream_write(o,"null");
+        write_literal(o, "null");
         break;
     }
 }
 
-template <unsigned int IndentWidth, typename T>
-inline void write(std::ostream& o, const T& val)
+template <typename Indenter, typename Out, typename T>
+inline void write(Out& o, const T& val, const Indenter& indent)
 {
-    using indent_type = indenter<IndentWidth>;
-
     std::stack<stack_value> stack;
     stack.emplace(val.cbegin(), val.cend(), val.cbegin(), 1);
 
@@ -667,11 +1767,10 @@ inline void write(std::ostream& o, const T& val)
             if (top.object_empty())
             {
                 //{}
-                indent_type::object_open(o);
-                indent_type::object_close(o, top.depth);
+                write_literal(o, "{}");
 
                 if (!stack.empty())
-                    indent_type::comma(o, stack.top());
+                    indent.comma(o, stack.top());
                 
                 continue;
             }
@@ -679,7 +1778,7 @@ inline void write(std::ostream& o, const T& val)
             if (top.at_object_start())
             {
                 //{
-                indent_type::object_open(o);
+                indent.object_open(o);
             }
 
             auto last_comma = top.object_pos.end;
@@ -688,9 +1787,9 @@ inline void write(std::ostream& o, const T& val)
             for (auto& pos = top.object_pos.pos; pos != top.object_pos.end; ++pos)
             {
                 //string
-                indent_type::indent(o, top.depth);
+                indent.indent(o, top.depth);
                 write_string(o, pos->first);
-                indent_type::colon(o);
+                indent.colon(o);
 
                 //value
                 switch (pos->second.type())
@@ -721,24 +1820,23 @@ inline void write(std::ostream& o, const T& val)
                 }
 
                 if (pos != last_comma)
-                    indent_type::comma(o);
+                    indent.comma(o);
             }
 
-            indent_type::object_close(o, top.depth);
+            indent.object_close(o, top.depth);
 
             if (!stack.empty())
-                indent_type::comma(o, stack.top());
+                indent.comma(o, stack.top());
         }
         else
         {
             if (top.array_empty())
             {
                 //[]
-                indent_type::array_open(o);
-                indent_type::array_close(o, top.depth);
+                write_literal(o, "[]");
 
                 if (!stack.empty())
-                    indent_type::comma(o, stack.top());
+                    indent.comma(o, stack.top());
 
                 continue;
             }
@@ -746,7 +1844,7 @@ inline void write(std::ostream& o, const T& val)
             if (top.at_array_start())
             {
                 //[
-                indent_type::array_open(o);
+                indent.array_open(o);
             }
 
             auto last_comma = top.array_pos.end;
@@ -754,7 +1852,7 @@ inline void write(std::ostream& o, const T& val)
 
             for (auto& pos = top.array_pos.pos; pos != top.array_pos.end; ++pos)
             {
-                indent_type::indent(o, top.depth);
+                indent.indent(o, top.depth);
                 switch (pos->type())
                 {
                 case e_JsonType::Object:
@@ -783,36 +1881,58 @@ inline void write(std::ostream& o, const T& val)
                 }
 
                 if (pos != last_comma)
-                    indent_type::comma(o);
+                    indent.comma(o);
             }
 
-            indent_type::array_close(o, top.depth);
+            indent.array_close(o, top.depth);
 
             if (!stack.empty())
-                indent_type::comma(o, stack.top());
+                indent.comma(o, stack.top());
         }
     }
 }
 
-} //impl
-
-template <unsigned int IndentWidth>
-void write_pretty(std::ostream& o, const Value& val)
+template <typename Indenter, typename Out>
+inline void write_value(Out& o, const Value& val, const Indenter& indent)
 {
     switch (val.type())
     {
     case e_JsonType::Object:
-        impl::write<IndentWidth>(o, val.get<e_JsonType::Object>());
+        write(o, val.get<e_JsonType::Object>(), indent);
         break;
     case e_JsonType::Array:
-        impl::write<IndentWidth>(o, val.get<e_JsonType::Array>());
+        write(o, val.get<e_JsonType::Array>(), indent);
         break;
     default:
-        impl::write_simple_value(o, val);
+        write_simple_value(o, val);
         break;
     }
 }
 
+} //impl
+
+template <unsigned int IndentWidth>
+void write_pretty(std::ostream& o, const Value& val)
+{
+    impl::write_value(o, val, impl::indenter<IndentWidth>());
+}
+
+template <unsigned int IndentWidth>
+void write_pretty(std::string& out, const Value& val)
+{
+    impl::output o{out};
+    impl::write_value(o, val, impl::indenter<IndentWidth>());
+    o.finish();
+}
+
+template <unsigned int IndentWidth>
+void write_pretty(const Sink& sink, const Value& val, std::size_t block_size)
+{
+    impl::output o{sink, block_size};
+    impl::write_value(o, val, impl::indenter<IndentWidth>());
+    o.finish();
+}
+
 } //jsonish
 
 #endif //JSONISH_H
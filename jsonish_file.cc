@@ -0,0 +1,290 @@
+/*
+ Copyright (c) 2013, Kipp Hickman
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "jsonish.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define JSONISH_MMAP 1
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
+namespace jsonish
+{
+
+namespace impl
+{
+
+mapped_file::~mapped_file()
+{
+#ifdef JSONISH_MMAP
+    if (m_mapped)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+        return;
+    }
+#endif
+    delete[] m_data;
+}
+
+bool mapped_file::open(const char* path)
+{
+#ifdef JSONISH_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    m_size = static_cast<std::size_t>(info.st_size);
+
+    //an empty file can't be mapped, and doesn't need to be
+    if (m_size == 0)
+    {
+        close(fd);
+        m_data = new char[1];
+        return true;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    //the Lexer reads front to back, let the kernel read ahead aggressively
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    madvise(data, m_size, MADV_WILLNEED);
+
+    m_data = static_cast<const char*>(data);
+    m_mapped = true;
+    return true;
+#else
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file)
+        return false;
+
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (size < 0)
+    {
+        std::fclose(file);
+        return false;
+    }
+
+    m_size = static_cast<std::size_t>(size);
+    char* data = new char[m_size + 1];
+    m_data = data;
+    bool ok = std::fread(data, 1, m_size, file) == m_size;
+    std::fclose(file);
+    return ok;
+#endif
+}
+
+#ifdef JSONISH_MMAP
+/*
+  Output for write_fd. Everything handed to write() stays put until the
+  Value is written, so long strings become iovecs of their own and only the
+  pieces in between are copied, into a block that is flushed when full.
+*/
+class fd_output
+{
+  public:
+    explicit fd_output(int fd)
+        : m_fd{fd},
+          m_block(64 * 1024),
+          m_pos{m_block.data()},
+          m_end{m_pos + m_block.size()},
+          m_pending{m_pos},
+          m_count{0},
+          m_failed{false} { }
+
+    void put(char c)
+    {
+        if (m_pos == m_end)
+            make_room();
+        *m_pos++ = c;
+    }
+
+    void write(const char* s, std::size_t n)
+    {
+        if (n >= s_min_slice)
+        {
+            close_block();
+            push(s, n);
+            return;
+        }
+
+        if (static_cast<std::size_t>(m_end - m_pos) < n)
+            make_room();
+        std::memcpy(m_pos, s, n);
+        m_pos += n;
+    }
+
+    char* reserve(std::size_t n)
+    {
+        if (static_cast<std::size_t>(m_end - m_pos) < n)
+            make_room();
+        return m_pos;
+    }
+
+    void commit(char* end) { m_pos = end; }
+
+    bool finish()
+    {
+        close_block();
+        flush();
+        return !m_failed;
+    }
+
+  private:
+    static const std::size_t s_min_slice = 256;
+    static const int s_max_iovecs = IOV_MAX < 1024 ? IOV_MAX : 1024;
+
+    //the block written since the last iovec becomes one
+    void close_block()
+    {
+        if (m_pos != m_pending)
+            push(m_pending, m_pos - m_pending);
+        m_pending = m_pos;
+    }
+
+    void push(const char* s, std::size_t n)
+    {
+        if (m_count == s_max_iovecs)
+            flush();
+        m_iovecs[m_count].iov_base = const_cast<char*>(s);
+        m_iovecs[m_count].iov_len = n;
+        ++m_count;
+    }
+
+    void make_room()
+    {
+        close_block();
+        flush();
+        m_pos = m_pending = m_block.data();
+    }
+
+    void flush()
+    {
+        auto iovecs = m_iovecs;
+        auto count = m_count;
+        m_count = 0;
+        while (count > 0 && !m_failed)
+        {
+            auto written = ::writev(m_fd, iovecs, count);
+            if (written < 0)
+            {
+                if (errno != EINTR)
+                    m_failed = true;
+                continue;
+            }
+
+            //a short write leaves the rest of the iovecs for the next call
+            auto left = static_cast<std::size_t>(written);
+            while (count > 0 && left >= iovecs->iov_len)
+            {
+                left -= iovecs->iov_len;
+                ++iovecs;
+                --count;
+            }
+            if (count > 0)
+            {
+                iovecs->iov_base = static_cast<char*>(iovecs->iov_base) + left;
+                iovecs->iov_len -= left;
+            }
+        }
+    }
+
+    int m_fd;
+    std::vector<char> m_block;
+    char* m_pos;
+    char* m_end;
+    char* m_pending;
+    struct iovec m_iovecs[s_max_iovecs];
+    int m_count;
+    bool m_failed;
+};
+#endif
+
+} //impl
+
+String Document::input() const
+{
+    if (m_files.empty())
+        return String(nullptr, nullptr);
+    return String(m_files.front()->begin(), m_files.front()->end());
+}
+
+bool parse_file(const char* path, Document& document, Error& error)
+{
+    std::unique_ptr<impl::mapped_file> file(new impl::mapped_file);
+    if (!file->open(path))
+    {
+        document.clear();
+        error = Error(nullptr, "Could not read file");
+        return false;
+    }
+
+    Parser parser(file->begin(), file->end());
+    bool ok = parser.parse(document, error);
+
+    document.m_files.push_back(std::move(file));
+    return ok;
+}
+
+bool parse_file(const std::string& path, Document& document, Error& error)
+{
+    return parse_file(path.c_str(), document, error);
+}
+
+bool write_fd(int fd, const Value& val, Error& error)
+{
+#ifdef JSONISH_MMAP
+    impl::fd_output o{fd};
+    impl::write_value(o, val, impl::indenter<0>());
+    if (o.finish())
+        return true;
+    error = Error(nullptr, "Could not write file");
+    return false;
+#else
+    error = Error(nullptr, "write_fd needs a POSIX system");
+    return false;
+#endif
+}
+
+} //jsonish
@@ -0,0 +1,140 @@
+/*
+ jsonish_number.hpp - Number decoding used by the Reader.
+ jsonish_simd.hpp - Vectorized scanning kernels used by the Lexer.
+
+ Copyright (c) 2013, Kipp Hickman
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef JSONISH_NUMBER_H
+#define JSONISH_NUMBER_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace jsonish
+{
+
+namespace impl
+{
+
+enum class e_NumberStatus : uint8_t
+{
+    Ok = 0,
+    Overflow,
+    Underflow,
+    Malformed
+};
+
+//the next 8 bytes as one little endian word
+inline std::uint64_t load_eight(const char* p)
+{
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+//true if every byte of word is an ASCII digit
+inline bool eight_digits(std::uint64_t word)
+{
+    return !(((word + 0x4646464646464646ULL) | (word - 0x3030303030303030ULL)) & 0x8080808080808080ULL);
+}
+
+//the value of 8 ASCII digits, the first in the lowest byte. Pairs, then quads, then the whole word
+inline std::uint32_t eight_digits_value(std::uint64_t word)
+{
+    word -= 0x3030303030303030ULL;
+    word = (word * 10) + (word >> 8);
+    word = (((word & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+            (((word >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+    return static_cast<std::uint32_t>(word);
+}
+
+/*
+  Decode an optional '-' followed by decimal digits in [start, end), 8 digits
+  at a time while that many remain. Anything else is Malformed, a value
+  outside of long long is Overflow or Underflow.
+*/
+inline e_NumberStatus decode_integer(const char* start, const char* end, long long& result)
+{
+    const bool negative = start != end && *start == '-';
+    auto pos = start + negative;
+    if (pos == end)
+        return e_NumberStatus::Malformed;
+
+    //leading zeros add no digits, after them at most 19 digits always fit
+    while (pos + 1 < end && *pos == '0')
+        ++pos;
+    if (end - pos > 20)
+    {
+        for (auto p = pos; p != end; ++p)
+        {
+            if (*p < '0' || *p > '9')
+                return e_NumberStatus::Malformed;
+        }
+        return negative ? e_NumberStatus::Underflow : e_NumberStatus::Overflow;
+    }
+
+    std::uint64_t value = 0;
+    for (; end - pos >= 8; pos += 8)
+    {
+        const auto word = load_eight(pos);
+        if (!eight_digits(word))
+            return e_NumberStatus::Malformed;
+        value = value * 100000000 + eight_digits_value(word);
+    }
+
+    //20 digits can only be stored if the 20th doesn't overflow
+    for (; pos != end; ++pos)
+    {
+        const unsigned int digit = static_cast<unsigned char>(*pos) - '0';
+        if (digit > 9)
+            return e_NumberStatus::Malformed;
+        if (value > (UINT64_MAX - digit) / 10)
+            return negative ? e_NumberStatus::Underflow : e_NumberStatus::Overflow;
+        value = value * 10 + digit;
+    }
+
+    const std::uint64_t limit = std::uint64_t(INT64_MAX) + negative;
+    if (value > limit)
+        return negative ? e_NumberStatus::Underflow : e_NumberStatus::Overflow;
+
+    result = negative ? static_cast<long long>(0 - value) : static_cast<long long>(value);
+    return e_NumberStatus::Ok;
+}
+
+/*
+  Decode a JSON number in [start, end) to the nearest double, independent of
+  the locale. Overflow means it rounds to infinity and Underflow that a
+  nonzero number rounds to zero.
+*/
+e_NumberStatus decode_float(const char* start, const char* end, double& result);
+
+} //impl
+
+} //jsonish
+
+#endif //JSONISH_NUMBER_H
@@ -0,0 +1,510 @@
+/*
+ Copyright (c) 2013, Kipp Hickman
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "jsonish.hpp"
+#include "jsonish_simd.hpp"
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <mutex>
+#include <thread>
+
+namespace jsonish
+{
+
+namespace impl
+{
+
+static const std::size_t s_min_chunk_size = 64 * 1024;
+static const std::size_t s_max_chunk_size = 4 * 1024 * 1024;
+
+struct line_chunk
+{
+    const char* start;
+    const char* end;
+    std::size_t first_line;
+};
+
+//cut [start, end) into pieces of about chunk_size that end just after a newline
+static std::vector<line_chunk> split_lines(const char* start, const char* end, std::size_t chunk_size)
+{
+    std::vector<line_chunk> chunks;
+    while (start != end)
+    {
+        auto cut = end;
+        if (static_cast<std::size_t>(end - start) > chunk_size)
+        {
+            auto newline = static_cast<const char*>(std::memchr(start + chunk_size, '\n',
+                                                                end - start - chunk_size));
+            if (newline)
+                cut = newline + 1;
+        }
+
+        chunks.push_back(line_chunk{start, cut, 0});
+        start = cut;
+    }
+    return chunks;
+}
+
+//run work(thread, i) for every i in [0, count) on threads threads, the calling thread is thread 0
+template <typename Work>
+static void run_parallel(unsigned int threads, std::size_t count, Work work)
+{
+    std::atomic<std::size_t> next(0);
+    auto worker = [&](unsigned int thread)
+    {
+        for (auto i = next++; i < count; i = next++)
+            work(thread, i);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < threads; ++t)
+        pool.emplace_back(worker, t);
+
+    worker(0);
+    for (auto& thread : pool)
+        thread.join();
+}
+
+//the records of one chunk, kept until every earlier chunk has been delivered
+struct parsed_chunk
+{
+    struct record
+    {
+        std::size_t line;
+        bool ok;
+        Value value;
+        Error error;
+    };
+
+    std::unique_ptr<Document> document;
+    std::vector<record> records;
+    bool ready;
+
+    parsed_chunk() : ready(false) { }
+};
+
+
+/*
+  Finds the elements of a top level Array without parsing them. The input is
+  cut into chunks, and each chunk is classified with the Lexer's block kernels
+  in two parallel passes:
+   1. count the quotes, which tells every chunk whether it starts inside a string
+   2. follow the nesting depth relative to the chunk's start
+  The top level ',' are the ones at depth 1 and the end of the Array is the
+  first ']' back at depth 0. Depth only ever moves by one, so a chunk only
+  needs to remember the ',' at its lowest relative depth and one above it.
+  Anything that doesn't look like a well formed Array is left to the serial
+  parse, which reports the error.
+*/
+class parallel_parser
+{
+  public:
+    static bool parse(const char* start, const char* end, unsigned int threads,
+                      Document* document, Value& result, Error& error);
+
+  private:
+    struct chunk_index
+    {
+        const char* start;
+        const char* end;
+        bool in_string;
+
+        //the first byte follows an odd run of backslashes
+        bool escaped;
+
+        //relative to the depth at start
+        long depth;
+        long min_depth;
+
+        //the first position at min_depth
+        const char* min_pos;
+
+        std::vector<const char*> commas_at_min;
+        std::vector<const char*> commas_above_min;
+    };
+
+    static void count_quotes(chunk_index& chunk);
+    static void index_chunk(chunk_index& chunk);
+    static bool find_elements(const char* start, const char* end, unsigned int threads,
+                              std::vector<const char*>& commas, const char*& close);
+};
+
+void parallel_parser::count_quotes(chunk_index& chunk)
+{
+    scan_block b;
+    unsigned int quotes = 0;
+    bool escaped = chunk.escaped;
+    for (auto p = chunk.start; p < chunk.end; p += 64)
+    {
+        classify_block(b, p, chunk.end, escaped);
+        escaped = b.escape_carry;
+        quotes += count_ones(b.quote);
+    }
+
+    //for now only parity, the next chunk's in_string is filled in from it
+    chunk.in_string = quotes & 1;
+}
+
+void parallel_parser::index_chunk(chunk_index& chunk)
+{
+    scan_block b;
+    std::uint64_t inside = chunk.in_string ? ~std::uint64_t(0) : 0;
+    long depth = 0;
+    long min_depth = LONG_MAX;
+    bool escaped = chunk.escaped;
+
+    for (auto p = chunk.start; p < chunk.end; p += 64)
+    {
+        classify_block(b, p, chunk.end, escaped);
+        escaped = b.escape_carry;
+
+        //opening quotes are inside their string, closing ones are not
+        inside = prefix_xor(b.quote) ^ (inside >> 63 ? ~std::uint64_t(0) : 0);
+
+        for (auto bits = b.structural & ~inside; bits; bits &= bits - 1)
+        {
+            auto pos = p + count_trailing_zeros(bits);
+            switch (*pos)
+            {
+            case '{':
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ']':
+                depth--;
+                break;
+            default:
+                break;
+            }
+
+            if (depth < min_depth)
+            {
+                min_depth = depth;
+                chunk.min_pos = pos;
+                chunk.commas_above_min.swap(chunk.commas_at_min);
+                chunk.commas_at_min.clear();
+            }
+
+            if (*pos == ',')
+            {
+                if (depth == min_depth)
+                    chunk.commas_at_min.push_back(pos);
+                else if (depth == min_depth + 1)
+                    chunk.commas_above_min.push_back(pos);
+            }
+        }
+    }
+
+    chunk.depth = depth;
+    chunk.min_depth = min_depth;
+}
+
+bool parallel_parser::find_elements(const char* start, const char* end, unsigned int threads,
+                                    std::vector<const char*>& commas, const char*& close)
+{
+    const std::size_t size = end - start;
+    auto chunk_size = std::max<std::size_t>(size / (threads * 4), 64 * 1024) & ~std::size_t(63);
+
+    std::vector<chunk_index> chunks;
+    for (auto p = start; p < end; p += std::min<std::size_t>(chunk_size, end - p))
+    {
+        std::size_t backslashes = 0;
+        while (p - backslashes != start && p[-1 - static_cast<std::ptrdiff_t>(backslashes)] == '\\')
+            ++backslashes;
+
+        chunks.push_back(chunk_index{p, p + std::min<std::size_t>(chunk_size, end - p), false, backslashes % 2 == 1,
+                                     0, 0, nullptr, {}, {}});
+    }
+
+    run_parallel(threads, chunks.size(), [&](unsigned int, std::size_t i) { count_quotes(chunks[i]); });
+
+    bool in_string = false;
+    for (auto& chunk : chunks)
+    {
+        bool odd = chunk.in_string;
+        chunk.in_string = in_string;
+        in_string ^= odd;
+    }
+
+    run_parallel(threads, chunks.size(), [&](unsigned int, std::size_t i) { index_chunk(chunks[i]); });
+
+    long depth = 0;
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.min_depth != LONG_MAX)
+        {
+            auto lowest = depth + chunk.min_depth;
+            if (lowest < 0)
+                return false;
+
+            if (lowest == 1)
+                commas.insert(commas.end(), chunk.commas_at_min.begin(), chunk.commas_at_min.end());
+
+            if (lowest == 0)
+            {
+                for (auto comma : chunk.commas_above_min)
+                {
+                    if (comma < chunk.min_pos)
+                        commas.push_back(comma);
+                }
+
+                close = chunk.min_pos;
+                return *close == ']';
+            }
+        }
+        depth += chunk.depth;
+    }
+
+    return false;
+}
+
+bool parallel_parser::parse(const char* start, const char* end, unsigned int threads,
+                            Document* document, Value& result, Error& error)
+{
+    auto serial = [&]()
+    {
+        Parser parser(start, end);
+        if (document)
+            return parser.parse(*document, error);
+        return parser.parse(result, error);
+    };
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto open = start;
+    while (open != end && std::isspace(static_cast<unsigned char>(*open)))
+        ++open;
+
+    std::vector<const char*> commas;
+    const char* close = nullptr;
+    if (threads == 1 || open == end || *open != '[' ||
+        !find_elements(start, end, threads, commas, close) || commas.empty())
+    {
+        return serial();
+    }
+
+    //declared first, the runs' Values may live in these documents
+    struct worker_state
+    {
+        Parser parser;
+        Document document;
+
+        worker_state() : parser(nullptr, nullptr) { }
+    };
+    std::vector<worker_state> states(threads);
+
+    //group the elements into a few runs per thread of about the same size
+    struct element_run
+    {
+        const char* start;
+        const char* end;
+        Value elements;
+        bool ok;
+    };
+
+    const std::size_t run_size = (close - open) / (threads * 8) + 1;
+    std::vector<element_run> runs;
+    auto run_start = open + 1;
+    for (auto comma : commas)
+    {
+        if (static_cast<std::size_t>(comma - run_start) >= run_size)
+        {
+            runs.push_back(element_run{run_start, comma + 1, Value(), false});
+            run_start = comma + 1;
+        }
+    }
+
+    //the last run also checks that nothing but whitespace follows the Array
+    runs.push_back(element_run{run_start, end, Value(), false});
+
+    run_parallel(threads, runs.size(), [&](unsigned int thread, std::size_t i)
+        {
+            auto& run = runs[i];
+            auto& state = states[thread];
+            Error ignored;
+            run.ok = state.parser.parse_elements(run.start, run.end, i + 1 == runs.size(),
+                                                 document ? &state.document : nullptr,
+                                                 run.elements, ignored);
+        });
+
+    //any error is reported by the serial parse, so its position is exactly the same
+    std::size_t count = 0;
+    for (const auto& run : runs)
+    {
+        if (!run.ok)
+            return serial();
+        count += run.elements.get<e_JsonType::Array>().size();
+    }
+
+    if (document)
+        document->clear();
+
+    Array array = document ? document->make_array() : Array();
+    array.reserve(count);
+    for (auto& run : runs)
+    {
+        for (auto& element : run.elements.get<e_JsonType::Array>())
+            array.push_back(std::move(element));
+    }
+
+    if (document)
+    {
+        document->root() = Value(std::move(array));
+
+        //the elements stay in the memory of the document they were built in
+        for (auto& state : states)
+            document->adopt(state.document);
+    }
+    else
+    {
+        result = Value(std::move(array));
+    }
+
+    return true;
+}
+
+} //impl
+
+bool parse_parallel(const char* start, const char* end, unsigned int threads, Document& document, Error& error)
+{
+    return impl::parallel_parser::parse(start, end, threads, &document, document.root(), error);
+}
+
+bool parse_parallel(const char* start, const char* end, unsigned int threads, Value& result, Error& error)
+{
+    return impl::parallel_parser::parse(start, end, threads, nullptr, result, error);
+}
+
+void parse_ndjson(const char* start, const char* end, unsigned int threads, e_Order order,
+                  std::function<void(std::size_t line, Value& record)> on_record,
+                  std::function<void(std::size_t line, const Error& error)> on_error)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    //a few chunks per thread keeps the threads busy when record sizes vary
+    auto chunk_size = static_cast<std::size_t>(end - start) / (threads * 8);
+    chunk_size = std::min(std::max(chunk_size, impl::s_min_chunk_size), impl::s_max_chunk_size);
+
+    auto chunks = impl::split_lines(start, end, chunk_size);
+    threads = static_cast<unsigned int>(std::min<std::size_t>(threads, chunks.size()));
+    if (threads == 0)
+        return;
+
+    //line numbers need the newlines of every earlier chunk
+    std::vector<std::size_t> newlines(chunks.size());
+    impl::run_parallel(threads, chunks.size(), [&](unsigned int, std::size_t i)
+        {
+            newlines[i] = std::count(chunks[i].start, chunks[i].end, '\n');
+        });
+
+    std::size_t line = 1;
+    for (std::size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].first_line = line;
+        line += newlines[i];
+    }
+
+    //one parser per thread, nothing is shared between them
+    struct worker_state
+    {
+        NdjsonParser parser;
+        Document document;
+        Error error;
+
+        worker_state() : parser(nullptr, nullptr) { }
+    };
+    std::vector<worker_state> states(threads);
+
+    if (order == e_Order::Unordered)
+    {
+        impl::run_parallel(threads, chunks.size(), [&](unsigned int thread, std::size_t i)
+            {
+                auto& state = states[thread];
+                state.parser.reset(chunks[i].start, chunks[i].end, chunks[i].first_line);
+                while (!state.parser.done())
+                {
+                    if (state.parser.next(state.document, state.error))
+                        on_record(state.parser.line(), state.document.root());
+                    else
+                        on_error(state.parser.line(), state.error);
+                }
+            });
+        return;
+    }
+
+    std::vector<impl::parsed_chunk> parsed(chunks.size());
+    std::mutex delivery_mutex;
+    std::size_t next_delivery = 0;
+    bool delivering = false;
+
+    impl::run_parallel(threads, chunks.size(), [&](unsigned int thread, std::size_t i)
+        {
+            auto& state = states[thread];
+            auto& result = parsed[i];
+            result.document.reset(new Document);
+
+            state.parser.reset(chunks[i].start, chunks[i].end, chunks[i].first_line);
+            while (!state.parser.done())
+            {
+                result.records.emplace_back();
+                auto& record = result.records.back();
+                record.ok = state.parser.next(*result.document, record.value, record.error);
+                record.line = state.parser.line();
+            }
+
+            //whoever completes the oldest undelivered chunk delivers it and every ready chunk after it
+            std::unique_lock<std::mutex> lock(delivery_mutex);
+            result.ready = true;
+            if (delivering)
+                return;
+
+            delivering = true;
+            while (next_delivery < parsed.size() && parsed[next_delivery].ready)
+            {
+                auto& chunk = parsed[next_delivery];
+                lock.unlock();
+
+                for (auto& record : chunk.records)
+                {
+                    if (record.ok)
+                        on_record(record.line, record.value);
+                    else
+                        on_error(record.line, record.error);
+                }
+                chunk.records = std::vector<impl::parsed_chunk::record>();
+                chunk.document.reset();
+
+                lock.lock();
+                ++next_delivery;
+            }
+            delivering = false;
+        });
+}
+
+} //jsonish
@@ -0,0 +1,289 @@
+/*
+ Copyright (c) 2013, Kipp Hickman
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "jsonish.hpp"
+
+namespace jsonish
+{
+
+static const char* s_invalid_pointer = "Invalid JSON Pointer";
+
+Query::Query(const std::vector<std::string>& pointers)
+    : m_valid(true),
+      m_wildcards(false),
+      m_reader(nullptr, nullptr)
+{
+    for (const auto& pointer : pointers)
+        add(pointer);
+}
+
+Query::Query(std::initializer_list<std::string> pointers)
+    : m_valid(true),
+      m_wildcards(false),
+      m_reader(nullptr, nullptr)
+{
+    for (const auto& pointer : pointers)
+        add(pointer);
+}
+
+void Query::add(const std::string& pointer)
+{
+    m_pointers.emplace_back();
+    if (pointer.empty())
+        return;
+
+    if (pointer[0] != '/')
+    {
+        m_valid = false;
+        return;
+    }
+
+    auto& references = m_pointers.back();
+    for (std::size_t pos = 1; pos <= pointer.size(); )
+    {
+        auto end = pointer.find('/', pos);
+        if (end == std::string::npos)
+            end = pointer.size();
+
+        //~1 stands for '/' and ~0 for '~'
+        reference ref{std::string(), -1, false};
+        for (auto i = pos; i < end; ++i)
+        {
+            if (pointer[i] != '~')
+                ref.key += pointer[i];
+            else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+                ref.key += pointer[++i] == '0' ? '~' : '/';
+            else
+                m_valid = false;
+        }
+
+        ref.any = pointer.compare(pos, end - pos, "*") == 0;
+        m_wildcards = m_wildcards || ref.any;
+
+        //array positions are written without leading zeros
+        const auto& key = ref.key;
+        if (!key.empty() && key.size() < 19 && key.find_first_not_of("0123456789") == std::string::npos &&
+            (key[0] != '0' || key.size() == 1))
+            ref.index = std::stoll(key);
+
+        references.push_back(std::move(ref));
+        pos = end + 1;
+    }
+}
+
+bool Query::run(const char* start, const char* end,
+                std::function<void(std::size_t pointer, const Value& value)> on_match, Error& error)
+{
+    if (!m_valid)
+    {
+        error = Error(nullptr, s_invalid_pointer);
+        return false;
+    }
+
+    m_reader.reset(start, end);
+    m_live.clear();
+    m_frames.clear();
+    m_positions.clear();
+
+    //every pointer reaches the root
+    m_next.clear();
+    for (std::size_t i = 0; i < m_pointers.size(); ++i)
+        m_next.push_back(i);
+
+    //without wildcards a pointer can only match in one place, once every pointer
+    //has been there the rest of the input isn't needed
+    std::size_t remaining = m_wildcards ? SIZE_MAX : m_pointers.size();
+    m_done.assign(m_pointers.size(), false);
+
+    while (true)
+    {
+        const auto event = m_reader.next();
+        const auto depth = m_frames.size();
+        switch (event)
+        {
+        case e_Event::Key:
+            advance(depth, &m_reader.string(), -1);
+            continue;
+        case e_Event::EndObject:
+        case e_Event::EndArray:
+            m_live.resize(m_frames.back());
+            m_frames.pop_back();
+            m_positions.pop_back();
+            continue;
+        case e_Event::EndOfInput:
+            return true;
+        case e_Event::Error:
+            error = m_reader.error();
+            return false;
+        default:
+            break;
+        }
+
+        //a value, array elements are matched by position
+        if (depth && m_positions.back() >= 0)
+            advance(depth, nullptr, m_positions.back()++);
+
+        bool complete = false;
+        bool deeper = false;
+        for (auto pointer : m_next)
+        {
+            complete = complete || m_pointers[pointer].size() == depth;
+            deeper = deeper || m_pointers[pointer].size() > depth;
+        }
+
+        if (event == e_Event::StartObject || event == e_Event::StartArray)
+        {
+            if (complete)
+            {
+                //the whole container is wanted, let a Parser build it
+                if (m_reader.skip() == e_Event::Error)
+                {
+                    error = m_reader.error();
+                    return false;
+                }
+
+                Parser parser{m_reader.string().begin(), m_reader.string().end()};
+                Value value;
+                if (!parser.parse(value, error))
+                    return false;
+                if (!found(depth, value, on_match, remaining))
+                    return true;
+            }
+            else if (deeper)
+            {
+                m_frames.push_back(m_live.size());
+                m_live.insert(m_live.end(), m_next.begin(), m_next.end());
+                m_positions.push_back(event == e_Event::StartArray ? 0 : -1);
+            }
+            else if (m_reader.skip() == e_Event::Error)
+            {
+                error = m_reader.error();
+                return false;
+            }
+            continue;
+        }
+
+        if (!complete)
+            continue;
+
+        Value value;
+        switch (event)
+        {
+        case e_Event::String:        value = Value(m_reader.string());         break;
+        case e_Event::Integer:       value = Value(m_reader.integer());        break;
+        case e_Event::FloatingPoint: value = Value(m_reader.floating_point()); break;
+        case e_Event::True:          value = Value(true);                      break;
+        case e_Event::False:         value = Value(false);                     break;
+        default:                                                               break;
+        }
+        if (!found(depth, value, on_match, remaining))
+            return true;
+    }
+}
+
+void Query::advance(std::size_t depth, const String* key, long long position)
+{
+    //the pointers still alive in the innermost container are at the back of m_live
+    m_next.clear();
+    for (auto i = m_frames.back(); i < m_live.size(); ++i)
+    {
+        const auto pointer = m_live[i];
+        const auto& ref = m_pointers[pointer][depth - 1];
+        if (ref.any || (key ? key->equals(ref.key.data(), ref.key.size()) : ref.index == position))
+            m_next.push_back(pointer);
+    }
+}
+
+bool Query::found(std::size_t depth, const Value& value,
+                  const std::function<void(std::size_t, const Value&)>& on_match, std::size_t& remaining)
+{
+    for (auto pointer : m_next)
+    {
+        resolve(pointer, depth, value, on_match);
+        if (remaining != SIZE_MAX && !m_done[pointer])
+        {
+            m_done[pointer] = true;
+            remaining--;
+        }
+    }
+
+    //false once nothing more can match
+    return remaining != 0;
+}
+
+void Query::resolve(std::size_t pointer, std::size_t depth, const Value& value,
+                    const std::function<void(std::size_t, const Value&)>& on_match)
+{
+    const auto& references = m_pointers[pointer];
+    if (depth == references.size())
+    {
+        on_match(pointer, value);
+        return;
+    }
+
+    const auto& ref = references[depth];
+    if (value.type() == e_JsonType::Object)
+    {
+        const auto& object = value.get<e_JsonType::Object>();
+        if (ref.any)
+        {
+            for (const auto& member : object)
+                resolve(pointer, depth + 1, member.second, on_match);
+        }
+        else
+        {
+            auto pos = object.find(ref.key);
+            if (pos != object.end())
+                resolve(pointer, depth + 1, pos->second, on_match);
+        }
+    }
+    else if (value.type() == e_JsonType::Array)
+    {
+        const auto& array = value.get<e_JsonType::Array>();
+        if (ref.any)
+        {
+            for (const auto& element : array)
+                resolve(pointer, depth + 1, element, on_match);
+        }
+        else if (ref.index >= 0 && static_cast<std::size_t>(ref.index) < array.size())
+            resolve(pointer, depth + 1, array[ref.index], on_match);
+    }
+}
+
+
+bool extract(const char* start, const char* end, const std::vector<std::string>& pointers,
+             std::function<void(std::size_t pointer, const Value& value)> on_match, Error& error)
+{
+    Query query(pointers);
+    return query.run(start, end, std::move(on_match), error);
+}
+
+bool extract(const std::string& input, const std::vector<std::string>& pointers,
+             std::function<void(std::size_t pointer, const Value& value)> on_match, Error& error)
+{
+    return extract(input.data(), input.data() + input.length(), pointers, std::move(on_match), error);
+}
+
+} //jsonish
@@ -0,0 +1,1021 @@
+/*
+ Copyright (c) 2013, Kipp Hickman
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "jsonish_simd.hpp"
+
+#ifdef JSONISH_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace jsonish
+{
+
+namespace impl
+{
+
+enum e_CharClass : uint8_t
+{
+    e_Whitespace = 1,
+    e_Structural = 2,
+    e_Quote      = 4,
+    e_Backslash  = 8,
+    e_Control    = 16,
+    e_High       = 32
+};
+
+struct char_class_table
+{
+    uint8_t classes[256];
+
+    char_class_table()
+    {
+        std::fill_n(classes, 256, 0);
+
+        for (unsigned int c = 0; c < 0x20; ++c)
+            classes[c] = e_Control;
+        for (unsigned char c : {' ', '\n', '\t', '\r'})
+            classes[c] |= e_Whitespace;
+        for (unsigned char c : {'{', '}', '[', ']', ':', ','})
+            classes[c] = e_Structural;
+        classes[static_cast<unsigned char>('"')] = e_Quote;
+        classes[static_cast<unsigned char>('\\')] = e_Backslash;
+        for (unsigned int c = 0x80; c < 0x100; ++c)
+            classes[c] = e_High;
+    }
+};
+
+void classify_scalar(const char* p, scan_block& b)
+{
+    static const char_class_table s_char_classes;
+
+    std::uint64_t whitespace = 0;
+    std::uint64_t structural = 0;
+    std::uint64_t quote = 0;
+    std::uint64_t backslash = 0;
+    std::uint64_t control = 0;
+    std::uint64_t high = 0;
+
+    for (unsigned int i = 0; i < 64; ++i)
+    {
+        const uint8_t c = s_char_classes.classes[static_cast<unsigned char>(p[i])];
+        whitespace |= static_cast<std::uint64_t>(c & e_Whitespace) << i;
+        structural |= static_cast<std::uint64_t>((c & e_Structural) >> 1) << i;
+        quote      |= static_cast<std::uint64_t>((c & e_Quote) >> 2) << i;
+        backslash  |= static_cast<std::uint64_t>((c & e_Backslash) >> 3) << i;
+        control    |= static_cast<std::uint64_t>((c & e_Control) >> 4) << i;
+        high       |= static_cast<std::uint64_t>((c & e_High) >> 5) << i;
+    }
+
+    b.whitespace = whitespace;
+    b.structural = structural;
+    b.quote = quote;
+    b.backslash = backslash;
+    b.control = control;
+    b.high = high;
+}
+
+#ifdef JSONISH_X86_SIMD
+
+static inline std::uint64_t sse2_mask(const char* p, __m128i (*classify)(__m128i))
+{
+    std::uint64_t result = 0;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(classify(v)));
+        result |= static_cast<std::uint64_t>(bits) << (16 * i);
+    }
+    return result;
+}
+
+static inline __m128i sse2_whitespace(__m128i v)
+{
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+}
+
+static inline __m128i sse2_structural(__m128i v)
+{
+    //'{' | 0x20 == '{' and '[' | 0x20 == '{', same for the closing pair
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                     _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+}
+
+static inline __m128i sse2_quote(__m128i v)
+{
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+}
+
+static inline __m128i sse2_backslash(__m128i v)
+{
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+}
+
+//unsigned v <= 0x1f
+static inline __m128i sse2_control(__m128i v)
+{
+    return _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+}
+
+//bytes of 0x80 and above already have their top bit set
+static inline __m128i sse2_high(__m128i v)
+{
+    return v;
+}
+
+void classify_sse2(const char* p, scan_block& b)
+{
+    b.whitespace = sse2_mask(p, sse2_whitespace);
+    b.structural = sse2_mask(p, sse2_structural);
+    b.quote = sse2_mask(p, sse2_quote);
+    b.backslash = sse2_mask(p, sse2_backslash);
+    b.control = sse2_mask(p, sse2_control);
+    b.high = sse2_mask(p, sse2_high);
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const char* p, scan_block& b)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i carriage_return = _mm256_set1_epi8('\r');
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i last_control = _mm256_set1_epi8(0x1f);
+
+    std::uint64_t whitespace = 0;
+    std::uint64_t structural = 0;
+    std::uint64_t quotes = 0;
+    std::uint64_t backslashes = 0;
+    std::uint64_t controls = 0;
+    std::uint64_t high = 0;
+
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+        __m256i folded = _mm256_or_si256(v, case_bit);
+
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                                     _mm256_cmpeq_epi8(v, newline)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, tab),
+                                                     _mm256_cmpeq_epi8(v, carriage_return)));
+        __m256i st = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, open),
+                                                     _mm256_cmpeq_epi8(folded, close)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, colon),
+                                                     _mm256_cmpeq_epi8(v, comma)));
+        __m256i qt = _mm256_cmpeq_epi8(v, quote);
+        __m256i bs = _mm256_cmpeq_epi8(v, backslash);
+        __m256i ct = _mm256_cmpeq_epi8(_mm256_min_epu8(v, last_control), v);
+
+        const unsigned int shift = 32 * i;
+        whitespace |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(ws))) << shift;
+        structural |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(st))) << shift;
+        quotes     |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(qt))) << shift;
+        backslashes |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(bs))) << shift;
+        controls   |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(ct))) << shift;
+        high       |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(v))) << shift;
+    }
+
+    b.whitespace = whitespace;
+    b.structural = structural;
+    b.quote = quotes;
+    b.backslash = backslashes;
+    b.control = controls;
+    b.high = high;
+}
+
+#endif //JSONISH_X86_SIMD
+
+
+const char* find_string_special_scalar(const char* start, const char* end)
+{
+    while (start != end && *start != '"' && *start != '\\' && static_cast<unsigned char>(*start) >= 0x20)
+        ++start;
+    return start;
+}
+
+std::uint64_t string_special_mask_scalar(const char* p)
+{
+    std::uint64_t mask = 0;
+    for (unsigned int i = 0; i < 64; ++i)
+    {
+        const unsigned char c = p[i];
+        mask |= static_cast<std::uint64_t>(c == '"' || c == '\\' || c < 0x20) << i;
+    }
+    return mask;
+}
+
+#ifdef JSONISH_X86_SIMD
+
+static inline __m128i sse2_string_special(__m128i v)
+{
+    return _mm_or_si128(_mm_or_si128(sse2_quote(v), sse2_backslash(v)), sse2_control(v));
+}
+
+const char* find_string_special_sse2(const char* start, const char* end)
+{
+    for (; end - start >= 16; start += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(start));
+        auto bits = static_cast<unsigned int>(_mm_movemask_epi8(sse2_string_special(v)));
+        if (bits)
+            return start + count_trailing_zeros(bits);
+    }
+
+    return find_string_special_scalar(start, end);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_string_special(__m256i v)
+{
+    return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+                           _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v));
+}
+
+std::uint64_t string_special_mask_sse2(const char* p)
+{
+    return sse2_mask(p, sse2_string_special);
+}
+
+__attribute__((target("avx2")))
+std::uint64_t string_special_mask_avx2(const char* p)
+{
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(avx2_string_special(low))) |
+           static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(avx2_string_special(high)))) << 32;
+}
+
+__attribute__((target("avx2")))
+const char* find_string_special_avx2(const char* start, const char* end)
+{
+    for (; end - start >= 32; start += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(start));
+        auto bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(avx2_string_special(v)));
+        if (bits)
+            return start + count_trailing_zeros(bits);
+    }
+
+    //the compiler leaves out vzeroupper before a tail call, and legacy SSE code
+    //running with the upper halves of the ymm registers dirty is much slower
+    _mm256_zeroupper();
+    return find_string_special_sse2(start, end);
+}
+
+#endif //JSONISH_X86_SIMD
+
+
+/*
+  The length of the well formed UTF-8 sequence at p, or 0 if there is none.
+  Follows table 3-7 of the Unicode standard: no overlong forms, no
+  surrogates, nothing above U+10FFFF.
+*/
+static inline unsigned int utf8_sequence_length(const unsigned char* p, const unsigned char* end)
+{
+    const unsigned int lead = p[0];
+    unsigned int length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    if (lead >= 0xc2 && lead <= 0xdf)
+    {
+        length = 2;
+    }
+    else if (lead >= 0xe0 && lead <= 0xef)
+    {
+        length = 3;
+        if (lead == 0xe0)
+            low = 0xa0;
+        else if (lead == 0xed)
+            high = 0x9f;
+    }
+    else if (lead >= 0xf0 && lead <= 0xf4)
+    {
+        length = 4;
+        if (lead == 0xf0)
+            low = 0x90;
+        else if (lead == 0xf4)
+            high = 0x8f;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (end - p < static_cast<std::ptrdiff_t>(length) || p[1] < low || p[1] > high)
+        return 0;
+    for (unsigned int i = 2; i < length; ++i)
+    {
+        if (p[i] < 0x80 || p[i] > 0xbf)
+            return 0;
+    }
+    return length;
+}
+
+//the second character of the escapes the UTF-8 kernels pass over themselves
+static inline bool short_escape(unsigned char c)
+{
+    switch (c)
+    {
+    case '"':
+    case '\\':
+    case '/':
+    case 'b':
+    case 'f':
+    case 'n':
+    case 'r':
+    case 't':
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char* find_string_special_utf8_scalar(const char* start, const char* end, bool& escaped)
+{
+    auto p = reinterpret_cast<const unsigned char*>(start);
+    auto stop = reinterpret_cast<const unsigned char*>(end);
+    while (p != stop)
+    {
+        if (*p < 0x80)
+        {
+            if (*p == '\\' && stop - p >= 2 && short_escape(p[1]))
+            {
+                escaped = true;
+                p += 2;
+                continue;
+            }
+            if (*p == '"' || *p == '\\' || *p < 0x20)
+                break;
+            ++p;
+            continue;
+        }
+
+        auto length = utf8_sequence_length(p, stop);
+        if (!length)
+            break;
+        p += length;
+    }
+    return reinterpret_cast<const char*>(p);
+}
+
+//without a vectorized check every byte above ASCII needs the closer look
+std::uint64_t utf8_error_mask_scalar(const char* p)
+{
+    std::uint64_t mask = 0;
+    for (unsigned int i = 0; i < 64; ++i)
+        mask |= static_cast<std::uint64_t>(static_cast<unsigned char>(p[i]) >> 7) << i;
+    return mask;
+}
+
+#ifdef JSONISH_X86_SIMD
+
+//ASCII is passed over 16 bytes at a time, everything else is checked a sequence at a time
+const char* find_string_special_utf8_sse2(const char* start, const char* end, bool& escaped)
+{
+    auto p = reinterpret_cast<const unsigned char*>(start);
+    auto stop = reinterpret_cast<const unsigned char*>(end);
+    while (stop - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        auto bits = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(sse2_string_special(v), v)));
+        if (!bits)
+        {
+            p += 16;
+            continue;
+        }
+
+        p += count_trailing_zeros(bits);
+        if (*p < 0x80)
+        {
+            if (*p != '\\' || stop - p < 2 || !short_escape(p[1]))
+                return reinterpret_cast<const char*>(p);
+            escaped = true;
+            p += 2;
+            continue;
+        }
+
+        auto length = utf8_sequence_length(p, stop);
+        if (!length)
+            return reinterpret_cast<const char*>(p);
+        p += length;
+    }
+
+    return find_string_special_utf8_scalar(reinterpret_cast<const char*>(p), end, escaped);
+}
+
+std::uint64_t utf8_error_mask_sse2(const char* p)
+{
+    return sse2_mask(p, sse2_high);
+}
+
+/*
+  The lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less Than
+  One Instruction Per Byte". Each byte is checked against the one, two and
+  three before it with three table lookups. Error bits that one lookup sets
+  must be cleared by the others for the pair to be valid.
+*/
+namespace utf8
+{
+const std::uint8_t too_short      = 1 << 0;
+const std::uint8_t too_long       = 1 << 1;
+const std::uint8_t overlong_3     = 1 << 2;
+const std::uint8_t too_large      = 1 << 3;
+const std::uint8_t surrogate      = 1 << 4;
+const std::uint8_t overlong_2     = 1 << 5;
+const std::uint8_t too_large_1000 = 1 << 6;
+const std::uint8_t overlong_4     = 1 << 6;
+const std::uint8_t two_conts      = 1 << 7;
+const std::uint8_t carry          = too_short | too_long | two_conts;
+
+const std::uint8_t byte_1_high[16] = {
+    //ASCII
+    too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+    //continuation
+    two_conts, two_conts, two_conts, two_conts,
+    //lead of two, 0xc0 and 0xc1 are overlong
+    too_short | overlong_2,
+    too_short,
+    //lead of three
+    too_short | overlong_3 | surrogate,
+    //lead of four
+    too_short | too_large | too_large_1000 | overlong_4
+};
+
+const std::uint8_t byte_1_low[16] = {
+    carry | overlong_3 | overlong_2 | overlong_4,
+    carry | overlong_2,
+    carry,
+    carry,
+    carry | too_large,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000 | surrogate,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000
+};
+
+const std::uint8_t byte_2_high[16] = {
+    //ASCII
+    too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+    //0x80 - 0x8f
+    too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+    //0x90 - 0x9f
+    too_long | overlong_2 | two_conts | overlong_3 | too_large,
+    //0xa0 - 0xbf
+    too_long | overlong_2 | two_conts | surrogate | too_large,
+    too_long | overlong_2 | two_conts | surrogate | too_large,
+    //lead bytes
+    too_short, too_short, too_short, too_short
+};
+} //utf8
+
+/*
+  The offset of the first special character of a block read from data that
+  stops the scan, or width if none does. Two character escapes that end
+  inside the block are passed over, one split by its end is left to the
+  caller.
+*/
+static inline unsigned int utf8_block_stop(const char* data, std::uint32_t special, unsigned int width,
+                                           bool& escaped)
+{
+    while (special)
+    {
+        const unsigned int i = count_trailing_zeros(special);
+        if (data[i] != '\\' || i + 1 == width || !short_escape(data[i + 1]))
+            return i;
+
+        escaped = true;
+        special &= ~((std::uint32_t(4) << i) - 1);
+    }
+    return width;
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i ssse3_lookup(__m128i nibbles, const std::uint8_t (&table)[16])
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table)), nibbles);
+}
+
+//the bytes of input shifted along by N, with the end of previous shifted in
+template <int N>
+__attribute__((target("ssse3")))
+static inline __m128i ssse3_prev(__m128i input, __m128i previous)
+{
+    return _mm_alignr_epi8(input, previous, 16 - N);
+}
+
+//byte i is nonzero if the sequence that input[i] is part of, or ends, isn't well formed so far
+__attribute__((target("ssse3")))
+static inline __m128i ssse3_utf8_errors(__m128i input, __m128i previous)
+{
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+    const __m128i prev1 = ssse3_prev<1>(input, previous);
+    const __m128i special = _mm_and_si128(
+        _mm_and_si128(ssse3_lookup(_mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble), utf8::byte_1_high),
+                      ssse3_lookup(_mm_and_si128(prev1, low_nibble), utf8::byte_1_low)),
+        ssse3_lookup(_mm_and_si128(_mm_srli_epi16(input, 4), low_nibble), utf8::byte_2_high));
+
+    //the third and fourth bytes of a sequence are the continuations the lookups can't see
+    const __m128i third = _mm_subs_epu8(ssse3_prev<2>(input, previous), _mm_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+    const __m128i fourth = _mm_subs_epu8(ssse3_prev<3>(input, previous), _mm_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+    const __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+
+    return _mm_xor_si128(must_continue, special);
+}
+
+/*
+  Scan the block at data that has a special character in it, given the block
+  before it. Returns the offset of its first stop, 16 to go on to the next
+  block, or -1 if the text up to and including the stop isn't well formed.
+*/
+__attribute__((target("ssse3")))
+static inline int ssse3_utf8_stop(const char* data, std::uint32_t special, __m128i& previous, bool& escaped)
+{
+    const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const auto stop = utf8_block_stop(data, special, 16, escaped);
+    const auto errors = ~static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(ssse3_utf8_errors(input, previous), _mm_setzero_si128())));
+    if (errors & ((std::uint32_t(2) << stop) - 1))
+        return -1;
+
+    previous = input;
+    return stop;
+}
+
+/*
+  ASCII is passed over 16 bytes at a time. From the first byte above it
+  every block is checked with Keiser-Lemire, the errors piling up until a
+  block with a special character in it, or 64 bytes of nothing but ASCII,
+  says whether to look at them. Escapes don't interrupt the check.
+*/
+__attribute__((target("ssse3")))
+const char* find_string_special_utf8_ssse3(const char* start, const char* end, bool& escaped)
+{
+    //the escapes of a block are passed over before its check, the scalar kernel redoes both
+    const bool was_escaped = escaped;
+    __m128i previous = _mm_setzero_si128();
+    __m128i errors = _mm_setzero_si128();
+    bool checking = false;
+    unsigned int ascii_blocks = 0;
+
+    auto p = start;
+    while (end - p >= 16)
+    {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const auto special = static_cast<std::uint32_t>(_mm_movemask_epi8(sse2_string_special(input)));
+        if (!checking)
+        {
+            const auto high = static_cast<std::uint32_t>(_mm_movemask_epi8(input));
+            if (!(special | high))
+            {
+                p += 16;
+                continue;
+            }
+
+            if (!high || (special && count_trailing_zeros(special) < count_trailing_zeros(high)))
+            {
+                const auto stop = p + count_trailing_zeros(special);
+                if (*stop != '\\' || end - stop < 2 || !short_escape(stop[1]))
+                    return stop;
+                escaped = true;
+                p = stop + 2;
+                continue;
+            }
+
+            //ASCII ends every sequence, the block before is as good as none
+            checking = true;
+            ascii_blocks = 0;
+            previous = _mm_setzero_si128();
+        }
+
+        if (!special)
+        {
+            errors = _mm_or_si128(errors, ssse3_utf8_errors(input, previous));
+            previous = input;
+            p += 16;
+            ascii_blocks = _mm_movemask_epi8(input) ? 0 : ascii_blocks + 1;
+            if (ascii_blocks == 4)
+            {
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) != 0xffff)
+                    return find_string_special_utf8_scalar(start, end, escaped = was_escaped);
+                checking = false;
+            }
+            continue;
+        }
+
+        const int stop = ssse3_utf8_stop(p, special, previous, escaped);
+        if (stop < 0 || _mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) != 0xffff)
+            return find_string_special_utf8_scalar(start, end, escaped = was_escaped);
+        if (stop < 16)
+        {
+            //an escape split by the end of the block is passed over here
+            if (stop != 15 || p[15] != '\\' || end - p < 17 || !short_escape(p[16]))
+                return p + stop;
+            escaped = true;
+            p += 17;
+            continue;
+        }
+        p += 16;
+    }
+
+    //the tail is padded with zeros, control characters that stop the scan at end
+    char buf[16] = {};
+    std::memcpy(buf, p, end - p);
+    const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+    const auto special = static_cast<std::uint32_t>(_mm_movemask_epi8(sse2_string_special(input)));
+    const int stop = ssse3_utf8_stop(buf, special, previous, escaped);
+    if (stop < 0 || _mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) != 0xffff)
+        return find_string_special_utf8_scalar(start, end, escaped = was_escaped);
+    return p + stop;
+}
+
+__attribute__((target("ssse3")))
+std::uint64_t utf8_error_mask_ssse3(const char* p)
+{
+    __m128i previous = _mm_setzero_si128();
+    std::uint64_t mask = 0;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        const auto ok = static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(ssse3_utf8_errors(input, previous), _mm_setzero_si128())));
+        mask |= static_cast<std::uint64_t>(~ok & 0xffff) << (16 * i);
+        previous = input;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_lookup(__m256i nibbles, const std::uint8_t (&table)[16])
+{
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table))),
+                               nibbles);
+}
+
+//the bytes of input shifted along by N, with the end of previous shifted in
+template <int N>
+__attribute__((target("avx2")))
+static inline __m256i avx2_prev(__m256i input, __m256i previous)
+{
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+}
+
+//byte i is nonzero if the sequence that input[i] is part of, or ends, isn't well formed so far
+__attribute__((target("avx2")))
+static inline __m256i avx2_utf8_errors(__m256i input, __m256i previous)
+{
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+    const __m256i prev1 = avx2_prev<1>(input, previous);
+    const __m256i special = _mm256_and_si256(
+        _mm256_and_si256(avx2_lookup(_mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble), utf8::byte_1_high),
+                         avx2_lookup(_mm256_and_si256(prev1, low_nibble), utf8::byte_1_low)),
+        avx2_lookup(_mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble), utf8::byte_2_high));
+
+    //the third and fourth bytes of a sequence are the continuations the lookups can't see
+    const __m256i third = _mm256_subs_epu8(avx2_prev<2>(input, previous), _mm256_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+    const __m256i fourth = _mm256_subs_epu8(avx2_prev<3>(input, previous), _mm256_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+    const __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+    return _mm256_xor_si256(must_continue, special);
+}
+
+//the same as ssse3_utf8_stop, 32 bytes at a time
+__attribute__((target("avx2")))
+static inline int avx2_utf8_stop(const char* data, std::uint32_t special, __m256i& previous, bool& escaped)
+{
+    const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const auto stop = utf8_block_stop(data, special, 32, escaped);
+    const auto errors = ~static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(avx2_utf8_errors(input, previous), _mm256_setzero_si256())));
+    if (errors & (stop < 32 ? (std::uint32_t(2) << stop) - 1 : ~std::uint32_t(0)))
+        return -1;
+
+    previous = input;
+    return stop;
+}
+
+//the same as find_string_special_utf8_ssse3, 32 bytes at a time
+__attribute__((target("avx2")))
+const char* find_string_special_utf8_avx2(const char* start, const char* end, bool& escaped)
+{
+    const bool was_escaped = escaped;
+    __m256i previous = _mm256_setzero_si256();
+    __m256i errors = _mm256_setzero_si256();
+    bool checking = false;
+    unsigned int ascii_blocks = 0;
+
+    auto p = start;
+    while (end - p >= 32)
+    {
+        const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const auto special = static_cast<std::uint32_t>(_mm256_movemask_epi8(avx2_string_special(input)));
+        if (!checking)
+        {
+            const auto high = static_cast<std::uint32_t>(_mm256_movemask_epi8(input));
+            if (!(special | high))
+            {
+                p += 32;
+                continue;
+            }
+
+            if (!high || (special && count_trailing_zeros(special) < count_trailing_zeros(high)))
+            {
+                const auto stop = p + count_trailing_zeros(special);
+                if (*stop != '\\' || end - stop < 2 || !short_escape(stop[1]))
+                    return stop;
+                escaped = true;
+                p = stop + 2;
+                continue;
+            }
+
+            checking = true;
+            ascii_blocks = 0;
+            previous = _mm256_setzero_si256();
+        }
+
+        if (!special)
+        {
+            errors = _mm256_or_si256(errors, avx2_utf8_errors(input, previous));
+            previous = input;
+            p += 32;
+            ascii_blocks = _mm256_movemask_epi8(input) ? 0 : ascii_blocks + 1;
+            if (ascii_blocks == 2)
+            {
+                if (!_mm256_testz_si256(errors, errors))
+                {
+                    _mm256_zeroupper();
+                    return find_string_special_utf8_scalar(start, end, escaped = was_escaped);
+                }
+                checking = false;
+            }
+            continue;
+        }
+
+        const int stop = avx2_utf8_stop(p, special, previous, escaped);
+        if (stop < 0 || !_mm256_testz_si256(errors, errors))
+        {
+            _mm256_zeroupper();
+            return find_string_special_utf8_scalar(start, end, escaped = was_escaped);
+        }
+        if (stop < 32)
+        {
+            if (stop != 31 || p[31] != '\\' || end - p < 33 || !short_escape(p[32]))
+                return p + stop;
+            escaped = true;
+            p += 33;
+            continue;
+        }
+        p += 32;
+    }
+
+    alignas(32) char buf[32] = {};
+    std::memcpy(buf, p, end - p);
+    const __m256i input = _mm256_load_si256(reinterpret_cast<const __m256i*>(buf));
+    const auto special = static_cast<std::uint32_t>(_mm256_movemask_epi8(avx2_string_special(input)));
+    const int stop = avx2_utf8_stop(buf, special, previous, escaped);
+    if (stop < 0 || !_mm256_testz_si256(errors, errors))
+    {
+        _mm256_zeroupper();
+        return find_string_special_utf8_scalar(start, end, escaped = was_escaped);
+    }
+    return p + stop;
+}
+
+__attribute__((target("avx2")))
+std::uint64_t utf8_error_mask_avx2(const char* p)
+{
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    const auto low_ok = static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(avx2_utf8_errors(low, _mm256_setzero_si256()), _mm256_setzero_si256())));
+    const auto high_ok = static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(avx2_utf8_errors(high, low), _mm256_setzero_si256())));
+    return ~(low_ok | static_cast<std::uint64_t>(high_ok) << 32);
+}
+
+#endif //JSONISH_X86_SIMD
+
+
+typedef void (*classify_fn)(const char*, scan_block&);
+typedef const char* (*find_fn)(const char*, const char*);
+typedef const char* (*find_utf8_fn)(const char*, const char*, bool&);
+typedef std::uint64_t (*mask_fn)(const char*);
+
+struct simd_dispatch
+{
+    e_SimdLevel detected;
+    e_SimdLevel level;
+    classify_fn classify;
+    find_fn find_string_special;
+    find_utf8_fn find_string_special_utf8;
+    mask_fn string_special_mask;
+    mask_fn utf8_error_mask;
+
+    simd_dispatch() : detected(e_SimdLevel::Scalar)
+    {
+#ifdef JSONISH_X86_SIMD
+        detected = e_SimdLevel::SSE2;
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("ssse3"))
+            detected = e_SimdLevel::SSSE3;
+        if (__builtin_cpu_supports("avx2"))
+            detected = e_SimdLevel::AVX2;
+#endif
+        select(detected);
+    }
+
+    void select(e_SimdLevel l)
+    {
+        level = std::min(l, detected);
+        switch (level)
+        {
+#ifdef JSONISH_X86_SIMD
+        case e_SimdLevel::AVX2:
+            classify = classify_avx2;
+            find_string_special = find_string_special_avx2;
+            find_string_special_utf8 = find_string_special_utf8_avx2;
+            string_special_mask = string_special_mask_avx2;
+            utf8_error_mask = utf8_error_mask_avx2;
+            break;
+        //only UTF-8 validation gains from pshufb, the rest has nothing to look up
+        case e_SimdLevel::SSSE3:
+            classify = classify_sse2;
+            find_string_special = find_string_special_sse2;
+            find_string_special_utf8 = find_string_special_utf8_ssse3;
+            string_special_mask = string_special_mask_sse2;
+            utf8_error_mask = utf8_error_mask_ssse3;
+            break;
+        case e_SimdLevel::SSE2:
+            classify = classify_sse2;
+            find_string_special = find_string_special_sse2;
+            find_string_special_utf8 = find_string_special_utf8_sse2;
+            string_special_mask = string_special_mask_sse2;
+            utf8_error_mask = utf8_error_mask_sse2;
+            break;
+#endif
+        default:
+            classify = classify_scalar;
+            find_string_special = find_string_special_scalar;
+            find_string_special_utf8 = find_string_special_utf8_scalar;
+            string_special_mask = string_special_mask_scalar;
+            utf8_error_mask = utf8_error_mask_scalar;
+            break;
+        }
+    }
+};
+
+//function local so the Lexer is usable during static initialization of other translation units
+static simd_dispatch& dispatch()
+{
+    static simd_dispatch d;
+    return d;
+}
+
+e_SimdLevel detected_simd_level() { return dispatch().detected; }
+
+e_SimdLevel simd_level() { return dispatch().level; }
+
+void set_simd_level(e_SimdLevel level) { dispatch().select(level); }
+
+/*
+  Escaped characters follow a backslash that isn't itself escaped. Backslashes
+  only occur in strings, and rarely, so they are walked one at a time.
+*/
+static void apply_escapes(scan_block& b, bool first_escaped)
+{
+    std::uint64_t escaped = first_escaped ? 1 : 0;
+    auto escapes = b.backslash & ~escaped;
+    b.escape_carry = false;
+    while (escapes)
+    {
+        auto i = count_trailing_zeros(escapes);
+        if (i == 63)
+        {
+            b.escape_carry = true;
+            break;
+        }
+
+        escaped |= std::uint64_t(2) << i;
+        escapes &= ~((std::uint64_t(4) << i) - 1);
+    }
+
+    b.quote &= ~escaped;
+}
+
+void classify_block(scan_block& b, const char* start, const char* end, bool first_escaped)
+{
+    b.base = start;
+
+    if (end - start >= 64)
+    {
+        b.limit = start + 64;
+        dispatch().classify(start, b);
+    }
+    else
+    {
+        //pad the tail with whitespace so nothing past the end is ever reported
+        char buf[64];
+        auto length = end - start;
+        std::memcpy(buf, start, length);
+        std::memset(buf + length, ' ', 64 - length);
+
+        b.limit = end;
+        dispatch().classify(buf, b);
+    }
+
+    if (b.backslash || first_escaped)
+        apply_escapes(b, first_escaped);
+    else
+        b.escape_carry = false;
+    b.utf8_checked = false;
+}
+
+std::uint64_t utf8_error_mask(scan_block& b)
+{
+    if (b.utf8_checked)
+        return b.utf8_errors;
+
+    if (b.limit - b.base == 64)
+    {
+        b.utf8_errors = dispatch().utf8_error_mask(b.base);
+    }
+    else
+    {
+        //padded with whitespace the same as for classify
+        char buf[64];
+        auto length = b.limit - b.base;
+        std::memcpy(buf, b.base, length);
+        std::memset(buf + length, ' ', 64 - length);
+        b.utf8_errors = dispatch().utf8_error_mask(buf);
+    }
+    b.utf8_checked = true;
+    return b.utf8_errors;
+}
+
+const char* find_string_special(const char* start, const char* end)
+{
+    return dispatch().find_string_special(start, end);
+}
+
+const char* find_string_special_utf8(const char* start, const char* end, bool& escaped)
+{
+    return dispatch().find_string_special_utf8(start, end, escaped);
+}
+
+std::uint64_t string_special_mask(const char* start, const char* end)
+{
+    if (end - start >= 64)
+        return dispatch().string_special_mask(start);
+
+    //pad the tail with spaces, which never need escaping
+    char buf[64];
+    auto length = end - start;
+    std::memcpy(buf, start, length);
+    std::memset(buf + length, ' ', 64 - length);
+    return dispatch().string_special_mask(buf);
+}
+
+} //impl
+
+} //jsonish
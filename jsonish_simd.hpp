@@ -0,0 +1,153 @@
+/*
+ jsonish_simd.hpp - Vectorized scanning kernels used by the Lexer.
+
+ Copyright (c) 2013, Kipp Hickman
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef JSONISH_SIMD_H
+#define JSONISH_SIMD_H
+
+#include "jsonish.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define JSONISH_X86_SIMD 1
+#endif
+
+namespace jsonish
+{
+
+namespace impl
+{
+
+enum class e_SimdLevel : uint8_t
+{
+    Scalar = 0,
+    SSE2,
+    SSSE3,
+    AVX2
+};
+
+//the best level supported by the running cpu, detected once
+e_SimdLevel detected_simd_level();
+
+//the level the kernels currently dispatch to
+e_SimdLevel simd_level();
+
+//select the kernels to use, clamped to detected_simd_level(). Not thread safe.
+void set_simd_level(e_SimdLevel level);
+
+/*
+  Fill b with the classification of [start, min(start + 64, end)).
+  start must be before end. first_escaped is the escape_carry of the block
+  just before, when there is one.
+*/
+void classify_block(scan_block& b, const char* start, const char* end, bool first_escaped = false);
+
+//the individual kernels, each classifies exactly 64 readable bytes at p
+void classify_scalar(const char* p, scan_block& b);
+#ifdef JSONISH_X86_SIMD
+void classify_sse2(const char* p, scan_block& b);
+void classify_avx2(const char* p, scan_block& b);
+#endif
+
+//the first '"', '\\' or control character in [start, end), or end
+const char* find_string_special(const char* start, const char* end);
+
+//the same characters as a mask over [start, min(start + 64, end)), start must be before end
+std::uint64_t string_special_mask(const char* start, const char* end);
+
+//the individual kernels, each looks at exactly 64 readable bytes at p
+std::uint64_t string_special_mask_scalar(const char* p);
+#ifdef JSONISH_X86_SIMD
+std::uint64_t string_special_mask_sse2(const char* p);
+std::uint64_t string_special_mask_avx2(const char* p);
+#endif
+
+/*
+  The bytes of b that may not be part of well formed UTF-8, judged from b
+  alone and worked out once per block. A string inside b is well formed if
+  none of its bytes or its closing quote are in the mask. Without a
+  vectorized check that is every byte above ASCII.
+*/
+std::uint64_t utf8_error_mask(scan_block& b);
+
+//the individual kernels, each looks at exactly 64 readable bytes at p
+std::uint64_t utf8_error_mask_scalar(const char* p);
+#ifdef JSONISH_X86_SIMD
+std::uint64_t utf8_error_mask_sse2(const char* p);
+std::uint64_t utf8_error_mask_ssse3(const char* p);
+std::uint64_t utf8_error_mask_avx2(const char* p);
+#endif
+
+const char* find_string_special_scalar(const char* start, const char* end);
+#ifdef JSONISH_X86_SIMD
+const char* find_string_special_sse2(const char* start, const char* end);
+const char* find_string_special_avx2(const char* start, const char* end);
+#endif
+
+/*
+  The same, or the first byte in [start, end) that isn't part of well formed
+  UTF-8, whichever comes first. A sequence cut short by end or by a special
+  character isn't well formed. Two character escapes, every one but \u, are
+  passed over and set escaped, so that one check of a block covers all the
+  escapes in it.
+*/
+const char* find_string_special_utf8(const char* start, const char* end, bool& escaped);
+
+const char* find_string_special_utf8_scalar(const char* start, const char* end, bool& escaped);
+#ifdef JSONISH_X86_SIMD
+const char* find_string_special_utf8_sse2(const char* start, const char* end, bool& escaped);
+const char* find_string_special_utf8_ssse3(const char* start, const char* end, bool& escaped);
+const char* find_string_special_utf8_avx2(const char* start, const char* end, bool& escaped);
+#endif
+
+inline unsigned int count_ones(std::uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    unsigned int n = 0;
+    for (; x; x &= x - 1)
+        n++;
+    return n;
+#endif
+}
+
+//bit i is set if an odd number of bits at or below i are set in x
+inline std::uint64_t prefix_xor(std::uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+} //impl
+
+} //jsonish
+
+#endif //JSONISH_SIMD_H
@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../jsonish.hpp"
+
+/*
+  Doubles written by jsonish::write must parse back to exactly the same
+  double. Random bit patterns cover every exponent, the fixed values the
+  boundaries of each notation and of the double range.
+*/
+
+static bool same(double a, double b)
+{
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    std::mt19937_64 rng(argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2013);
+
+    std::vector<double> values = {
+        0.0, -0.0, 1.0, -1.0, 0.1, 0.5, 1.5, 100.0, 1e15, 1e16, 123456789012345.0,
+        1e-4, 1e-5, 0.001234, 1e21, 1e22, 1e23, 9007199254740993.0, 5e-324,
+        2.2250738585072009e-308, 2.2250738585072014e-308, 1.7976931348623157e308,
+        0.30000000000000004, 37.7749295, -122.4194155
+    };
+    while (values.size() < 1000000)
+    {
+        const auto bits = rng();
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        if (d == d && d - d == 0)
+            values.push_back(d);
+    }
+
+    jsonish::Array array;
+    for (auto d : values)
+        array.emplace_back(d);
+
+    std::ostringstream out;
+    jsonish::write(out, jsonish::Value(std::move(array)));
+    const std::string text = out.str();
+
+    jsonish::Parser parser{text};
+    jsonish::Value result;
+    jsonish::Error error;
+    if (!parser.parse(result, error))
+    {
+        std::cout << "round trip FAILED: " << error.message << "\n";
+        return 1;
+    }
+
+    std::size_t failures = 0;
+    const auto& parsed = result.get<jsonish::e_JsonType::Array>();
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        if (parsed[i].type() != jsonish::e_JsonType::FloatingPoint ||
+            !same(parsed[i].get<jsonish::e_JsonType::FloatingPoint>(), values[i]))
+        {
+            if (failures++ < 10)
+            {
+                char buf[32];
+                std::cout << "round trip FAILED: " << std::string(buf, jsonish::impl::format_double(buf, values[i]))
+                          << "\n";
+            }
+        }
+    }
+
+    std::cout << "round trip of " << values.size() << " doubles, " << failures << " failed\n";
+    return failures ? 1 : 0;
+}
@@ -27,6 +27,15 @@ for fail_file in fail/*.json; do
     fi
 done
 
+#programs that check a property over generated input rather than a file
+for program in round_trip utf8 string_round_trip; do
+    if ! ./$program; then
+        ((failing=$failing+1))
+    else
+        ((passing=$passing+1))
+    fi
+done
+
 echo "ran $(($passing+$failing)) tests"
 echo "\033[34m$passing passed\033[0m"
 echo "\033[31m$failing failed\033[0m"
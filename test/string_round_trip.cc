@@ -0,0 +1,94 @@
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../jsonish.hpp"
+#include "../jsonish_simd.hpp"
+
+/*
+  Strings that hold any characters at all, quotes, backslashes and control
+  characters included, must be escaped by jsonish::write so that they parse
+  back to exactly the same text. Written again, the parsed strings, escapes
+  and all, must give the same output. Each string kernel must escape the same.
+*/
+
+int main(int argc, char* argv[])
+{
+    std::mt19937 rng(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2013);
+
+    static const char* const pieces[] =
+    {
+        "plain text ", "\"", "\\", "\n", "\t", "\r", "\b", "\f", "\x01", "\x1f", "/", "\x7f",
+        "caf\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "0123456789abcdef0123456789abcdef"
+    };
+    std::uniform_int_distribution<std::size_t> piece(0, sizeof(pieces) / sizeof(pieces[0]) - 1);
+    std::uniform_int_distribution<std::size_t> count(0, 30);
+
+    std::vector<std::string> texts;
+    for (int i = 0; i < 20000; ++i)
+    {
+        std::string text;
+        for (auto n = count(rng); n > 0; --n)
+            text += pieces[piece(rng)];
+        texts.push_back(text);
+    }
+
+    jsonish::Array array;
+    for (const auto& text : texts)
+        array.emplace_back(jsonish::String(text.data(), text.data() + text.size()));
+    const jsonish::Value value(std::move(array));
+
+    std::ostringstream out;
+    jsonish::write(out, value);
+    std::string buffered;
+    jsonish::write(buffered, value);
+    if (buffered != out.str())
+    {
+        std::cout << "string round trip FAILED: string and ostream output differ\n";
+        return 1;
+    }
+    for (auto level : {jsonish::impl::e_SimdLevel::Scalar, jsonish::impl::e_SimdLevel::SSE2,
+                       jsonish::impl::e_SimdLevel::SSSE3, jsonish::impl::e_SimdLevel::AVX2})
+    {
+        jsonish::impl::set_simd_level(level);
+        std::string at_level;
+        jsonish::write(at_level, value);
+        if (at_level != buffered)
+        {
+            std::cout << "string round trip FAILED: kernels escape differently\n";
+            return 1;
+        }
+    }
+    jsonish::impl::set_simd_level(jsonish::impl::detected_simd_level());
+
+    const std::string json = out.str();
+    jsonish::Parser parser{json};
+    parser.validate_utf8(true);
+    jsonish::Value result;
+    jsonish::Error error;
+    if (!parser.parse(result, error))
+    {
+        std::cout << "string round trip FAILED: " << error.message << "\n";
+        return 1;
+    }
+
+    std::size_t failures = 0;
+    const auto& parsed = result.get<jsonish::e_JsonType::Array>();
+    for (std::size_t i = 0; i < texts.size(); ++i)
+    {
+        if (parsed[i].get<jsonish::e_JsonType::String>().to_string() != texts[i] && failures++ < 10)
+            std::cout << "string round trip FAILED: " << texts[i] << "\n";
+    }
+
+    std::ostringstream again;
+    jsonish::write(again, result);
+    if (again.str() != json)
+    {
+        std::cout << "string round trip FAILED: parsed strings are written differently\n";
+        ++failures;
+    }
+
+    std::cout << "string round trip of " << texts.size() << " strings, " << failures << " failed\n";
+    return failures ? 1 : 0;
+}
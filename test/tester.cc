@@ -1,18 +1,32 @@
+#include <cstdio>
 #include <fstream>
 #include <string>
+#include <sstream>
 #include <iostream>
 #include <utility>
+#include <vector>
 #include "../jsonish.hpp"
 
 std::string red(const std::string& s);
 std::string blue(const std::string& s);
 
-std::string read_file(const std::string& filename);
+bool parse_chunked(const jsonish::String& text, std::size_t chunk_size,
+                   std::vector<std::string>& chunks, jsonish::Document& result, jsonish::Error& error);
 
 int main(int argc, char *argv[])
 {
     std::string filename(argv[1]);
-    std::string text = read_file(filename);
+
+    //the file is mapped rather than copied, the Document it is parsed into keeps it
+    jsonish::Document document;
+    jsonish::Error file_error;
+    bool file_parsed = jsonish::parse_file(filename, document, file_error);
+    const jsonish::String text = document.input();
+    if (!text.begin())
+    {
+        std::cout << "test " << red("FAILED") << ": " << file_error.message << " " << filename << "\n\n";
+        return 1;
+    }
 
     std::string expect(argv[2]);
     bool expect_pass = expect == "pass";
@@ -27,7 +41,7 @@ int main(int argc, char *argv[])
     
     std::cout << "test: " << filename << " expected " << (expect_pass ? "pass" : "fail") << "\n";
 
-    jsonish::Parser parser{text};
+    jsonish::Parser parser{text.begin(), text.end()};
     bool parse_error = false;
     jsonish::Error error;
     jsonish::Value result = parser.parse([&parse_error,&error](const jsonish::Error& err)
@@ -38,6 +52,179 @@ int main(int argc, char *argv[])
 
     if (expect_pass && !parse_error)
     {
+        //the same input parsed into a Document must produce the same tree
+        std::ostringstream expected, actual;
+        jsonish::write(expected, result);
+        jsonish::write(actual, document.root());
+        if (!file_parsed || expected.str() != actual.str())
+        {
+            std::cout << "test " << red("FAILED") << " Document parse differs\n\n";
+            return 1;
+        }
+
+        //writing into a string or a sink with tiny blocks gives the same text as an ostream
+        std::string buffered, sunk;
+        jsonish::write(buffered, result);
+        jsonish::write([&sunk](const char* data, std::size_t size) { sunk.append(data, size); },
+                       result, 8);
+        std::ostringstream pretty, pretty_sunk, pretty_runtime;
+        jsonish::write_pretty(pretty, result);
+        jsonish::write_pretty(pretty_runtime, result, jsonish::Indent{4});
+        jsonish::write_pretty<4>([&pretty_sunk](const char* data, std::size_t size)
+                                 {
+                                     pretty_sunk.write(data, size);
+                                 },
+                                 result, 8);
+        if (buffered != expected.str() || sunk != expected.str() || pretty.str() != pretty_sunk.str() ||
+            pretty.str() != pretty_runtime.str())
+        {
+            std::cout << "test " << red("FAILED") << " buffered write differs\n\n";
+            return 1;
+        }
+
+        //and so does writing to a file descriptor
+        std::string from_fd;
+        if (std::FILE* file = std::tmpfile())
+        {
+            if (jsonish::write_fd(fileno(file), result, error))
+            {
+                std::rewind(file);
+                char buf[4096];
+                while (std::size_t n = std::fread(buf, 1, sizeof(buf), file))
+                    from_fd.append(buf, n);
+            }
+            std::fclose(file);
+        }
+        if (from_fd != expected.str())
+        {
+            std::cout << "test " << red("FAILED") << " write_fd differs\n\n";
+            return 1;
+        }
+
+        //parsing again without a reset finds nothing left, after one the same tree
+        jsonish::Value again;
+        jsonish::Error again_error;
+        std::ostringstream again_text;
+        if (parser.parse(again, again_error) ||
+            std::string(again_error.message) != "Top level must be an Object or an Array")
+        {
+            std::cout << "test " << red("FAILED") << " second parse without reset\n\n";
+            return 1;
+        }
+        parser.reset();
+        if (parser.parse(again, again_error))
+            jsonish::write(again_text, again);
+        if (expected.str() != again_text.str())
+        {
+            std::cout << "test " << red("FAILED") << " parse after reset differs\n\n";
+            return 1;
+        }
+
+        //a value can be replaced by one of its own children
+        jsonish::Value replaced(result);
+        const jsonish::Value& first_child = result.type() == jsonish::e_JsonType::Object
+            ? (result.get<jsonish::e_JsonType::Object>().empty()
+                   ? result : result.get<jsonish::e_JsonType::Object>().begin()->second)
+            : (result.get<jsonish::e_JsonType::Array>().empty()
+                   ? result : result.get<jsonish::e_JsonType::Array>().front());
+        std::ostringstream child_text, replaced_text;
+        jsonish::write(child_text, first_child);
+        if (replaced.type() == jsonish::e_JsonType::Object && !replaced.get<jsonish::e_JsonType::Object>().empty())
+            replaced = std::move(replaced.get<jsonish::e_JsonType::Object>().begin()->second);
+        else if (replaced.type() == jsonish::e_JsonType::Array && !replaced.get<jsonish::e_JsonType::Array>().empty())
+            replaced = std::move(replaced.get<jsonish::e_JsonType::Array>().front());
+        jsonish::write(replaced_text, replaced);
+        if (child_text.str() != replaced_text.str())
+        {
+            std::cout << "test " << red("FAILED") << " replacing a value by its child differs\n\n";
+            return 1;
+        }
+
+        //a heap container moved into a Document's tree is freed along with it
+        {
+            jsonish::Document edited;
+            jsonish::Parser{text.begin(), text.end()}.parse(edited, error);
+            jsonish::Array heap(3, jsonish::Value(1));
+            if (edited.root().type() == jsonish::e_JsonType::Object)
+                edited.root().get<jsonish::e_JsonType::Object>()["added by tester"] = jsonish::Value(std::move(heap));
+            else
+                edited.root().get<jsonish::e_JsonType::Array>().push_back(jsonish::Value(std::move(heap)));
+            edited.clear();
+        }
+
+        //and so must feeding it in small pieces that split every kind of token
+        std::vector<std::string> chunks;
+        jsonish::Document chunked;
+        std::ostringstream chunked_text;
+        if (parse_chunked(text, 3, chunks, chunked, error))
+            jsonish::write(chunked_text, chunked.root());
+        if (expected.str() != chunked_text.str())
+        {
+            std::cout << "test " << red("FAILED") << " chunked parse differs\n\n";
+            return 1;
+        }
+
+        //and so must parsing a top level array's elements on several threads
+        jsonish::Value parallel;
+        std::ostringstream parallel_text;
+        if (jsonish::parse_parallel(text.begin(), text.end(), 4, parallel, error))
+            jsonish::write(parallel_text, parallel);
+        if (expected.str() != parallel_text.str())
+        {
+            std::cout << "test " << red("FAILED") << " parallel parse differs\n\n";
+            return 1;
+        }
+
+        //and so must parsing lazily and then reading the whole tree
+        jsonish::Document lazy;
+        std::ostringstream lazy_text;
+        if (jsonish::Parser{text.begin(), text.end()}.parse_lazy(lazy, error))
+            jsonish::write(lazy_text, lazy.root());
+        if (expected.str() != lazy_text.str() || lazy.lazy_error().message)
+        {
+            std::cout << "test " << red("FAILED") << " lazy parse differs\n\n";
+            return 1;
+        }
+
+        //a Query for every member or element finds them all in order
+        std::ostringstream members_text, matches_text;
+        if (result.type() == jsonish::e_JsonType::Object)
+        {
+            for (const auto& member : result.get<jsonish::e_JsonType::Object>())
+                jsonish::write(members_text, member.second);
+        }
+        else
+        {
+            for (const auto& element : result.get<jsonish::e_JsonType::Array>())
+                jsonish::write(members_text, element);
+        }
+        if (!jsonish::extract(text.begin(), text.end(), {"/*"},
+                              [&matches_text](std::size_t, const jsonish::Value& value)
+                              {
+                                  jsonish::write(matches_text, value);
+                              },
+                              error) ||
+            members_text.str() != matches_text.str())
+        {
+            std::cout << "test " << red("FAILED") << " query results differ\n\n";
+            return 1;
+        }
+
+        //every member of an object is found by its interned Key, indexed or not
+        if (result.type() == jsonish::e_JsonType::Object)
+        {
+            const auto& object = result.get<jsonish::e_JsonType::Object>();
+            for (auto member = object.begin(); member != object.end(); ++member)
+            {
+                const jsonish::Key key(member->first.to_string());
+                if (object.find(key) != member || jsonish::Key(key.str()).data() != key.data())
+                {
+                    std::cout << "test " << red("FAILED") << " Key lookup differs\n\n";
+                    return 1;
+                }
+            }
+        }
+
         if (toplevel_object)
         {
             if (result.type() != jsonish::e_JsonType::Object)
@@ -77,6 +264,46 @@ int main(int argc, char *argv[])
     }
     else if (!expect_pass && parse_error)
     {
+        if (file_parsed || file_error.pos != error.pos || file_error.message != error.message)
+        {
+            std::cout << "test " << red("FAILED") << " parse_file reported a different error\n\n";
+            return 1;
+        }
+
+        std::vector<std::string> chunks;
+        jsonish::Document chunked;
+        jsonish::Error chunked_error;
+        if (parse_chunked(text, 3, chunks, chunked, chunked_error) ||
+            std::string(chunked_error.message) != error.message)
+        {
+            std::cout << "test " << red("FAILED") << " chunked parse reported a different error\n\n";
+            return 1;
+        }
+
+        jsonish::Value parallel;
+        jsonish::Error parallel_error;
+        if (jsonish::parse_parallel(text.begin(), text.end(), 4, parallel, parallel_error) ||
+            parallel_error.pos != error.pos || parallel_error.message != error.message)
+        {
+            std::cout << "test " << red("FAILED") << " parallel parse reported a different error\n\n";
+            return 1;
+        }
+
+        //a lazy parse finds the error once the tree is read, if not before
+        jsonish::Document lazy;
+        jsonish::Error lazy_error;
+        std::ostringstream lazy_text;
+        if (jsonish::Parser{text.begin(), text.end()}.parse_lazy(lazy, lazy_error))
+        {
+            jsonish::write(lazy_text, lazy.root());
+            lazy_error = lazy.lazy_error();
+        }
+        if (!lazy_error.message)
+        {
+            std::cout << "test " << red("FAILED") << " lazy parse missed the error\n\n";
+            return 1;
+        }
+
         //error expected and it happened
         std::cout << "test " << blue("PASSED") << ", expected parse error. Error is: '" 
                   << error.message << "'\n";
@@ -97,15 +324,19 @@ std::string blue(const std::string& s)
     return "\033[34m" + s + "\033[0m";
 }
 
-std::string read_file(const std::string& filename)
+bool parse_chunked(const jsonish::String& text, std::size_t chunk_size,
+                   std::vector<std::string>& chunks, jsonish::Document& result, jsonish::Error& error)
 {
-    std::ifstream stream(filename, std::ios::in | std::ios::ate);
-    
-    std::string result;
-    result.reserve(stream.tellg());
+    //every chunk is a separate allocation, the parser can't rely on them being contiguous
+    for (auto pos = text.begin(); pos < text.end(); pos += chunk_size)
+        chunks.emplace_back(pos, std::min<std::size_t>(chunk_size, text.end() - pos));
 
-    stream.seekg(0, std::ios::beg);
-    result.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    jsonish::Parser parser{result};
+    for (const auto& chunk : chunks)
+    {
+        if (!parser.feed(chunk.data(), chunk.data() + chunk.size(), error))
+            return false;
+    }
 
-    return result;
+    return parser.finish(error);
 }
@@ -0,0 +1,177 @@
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../jsonish.hpp"
+#include "../jsonish_simd.hpp"
+
+/*
+  Every UTF-8 validating string kernel must stop at the same first bad byte
+  or special character as the scalar one, which is checked against known
+  sequences first, and pass over the same escapes. Random text is built
+  mostly from valid sequences so that errors land anywhere in it, including
+  across the kernels' block boundaries. A Parser validating its input must
+  then report the error at that byte, however it is fed.
+*/
+
+using namespace jsonish;
+
+static std::size_t failures = 0;
+
+static void fail(const std::string& what, const std::string& text)
+{
+    if (failures++ < 10)
+    {
+        std::cout << "utf8 FAILED: " << what << ":";
+        for (unsigned char c : text)
+            std::cout << ' ' << std::hex << static_cast<unsigned int>(c) << std::dec;
+        std::cout << "\n";
+    }
+}
+
+static std::size_t first_invalid(const std::string& text, impl::e_SimdLevel level, bool& escaped)
+{
+    impl::set_simd_level(level);
+    escaped = false;
+    return impl::find_string_special_utf8(text.data(), text.data() + text.size(), escaped) - text.data();
+}
+
+static std::size_t first_invalid(const std::string& text, impl::e_SimdLevel level)
+{
+    bool escaped;
+    return first_invalid(text, level, escaped);
+}
+
+static void check_kernels(const std::string& text)
+{
+    bool expected_escaped;
+    const auto expected = first_invalid(text, impl::e_SimdLevel::Scalar, expected_escaped);
+    for (auto level : {impl::e_SimdLevel::SSE2, impl::e_SimdLevel::SSSE3, impl::e_SimdLevel::AVX2})
+    {
+        bool escaped;
+        if (first_invalid(text, level, escaped) != expected || escaped != expected_escaped)
+            fail("kernels disagree", text);
+    }
+    impl::set_simd_level(impl::detected_simd_level());
+}
+
+static void check_parser(const std::string& text, std::size_t invalid)
+{
+    const std::string json = "[\"" + text + "\"]";
+    const bool ok = invalid == text.size();
+
+    //short strings are checked from the Lexer's block, each level its own way
+    for (auto level : {impl::e_SimdLevel::Scalar, impl::e_SimdLevel::SSE2, impl::e_SimdLevel::SSSE3,
+                       impl::e_SimdLevel::AVX2})
+    {
+        impl::set_simd_level(level);
+        Parser parser{json};
+        parser.validate_utf8(true);
+        Value result;
+        Error error;
+        if (parser.parse(result, error) != ok || (!ok && error.pos != json.data() + 2 + invalid))
+            fail("parser", text);
+    }
+    impl::set_simd_level(impl::detected_simd_level());
+
+    //split into every pair of chunks, the bad byte may be in either or in the splice
+    for (std::size_t split = 1; split < json.size(); ++split)
+    {
+        std::string first(json, 0, split), second(json, split);
+        Document document;
+        Parser chunked{document};
+        chunked.validate_utf8(true);
+        Error chunked_error;
+        const bool chunked_ok = chunked.feed(first.data(), first.data() + first.size(), chunked_error) &&
+                                chunked.feed(second.data(), second.data() + second.size(), chunked_error) &&
+                                chunked.finish(chunked_error);
+        if (chunked_ok != ok)
+            fail("chunked parser", text);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::mt19937 rng(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2013);
+
+    struct { const char* text; std::size_t invalid; } known[] =
+    {
+        { "plain ASCII", 11 },
+        { "caf\xc3\xa9", 5 },
+        { "\xe2\x82\xac euro", 8 },
+        { "\xf0\x9f\x98\x80", 4 },
+        { "\xf4\x8f\xbf\xbf", 4 },
+        { "\xed\x9f\xbf", 3 },
+        { "\xee\x80\x80", 3 },
+        { "a\x80", 1 },
+        { "\xc0\xaf", 0 },
+        { "\xc1\xbf", 0 },
+        { "\xe0\x9f\xbf", 0 },
+        { "\xed\xa0\x80", 0 },
+        { "\xf0\x8f\xbf\xbf", 0 },
+        { "\xf4\x90\x80\x80", 0 },
+        { "\xf5\x80\x80\x80", 0 },
+        { "\xff", 0 },
+        { "ab\xe2\x82", 2 },
+        { "ab\xc3", 2 },
+        { "\xc3\xa9\xc3", 2 },
+        { "\xe2\x82\x41", 0 },
+        { "a\\nb\\\"\xc3\xa9", 8 },
+        { "\xc3\\n", 0 }
+    };
+    for (const auto& k : known)
+    {
+        const std::string text(k.text);
+        if (first_invalid(text, impl::e_SimdLevel::Scalar) != k.invalid)
+            fail("known sequence", text);
+        check_kernels(text);
+        check_parser(text, k.invalid);
+    }
+
+    //whole sequences and escapes, some sequences broken, with runs of ASCII in between
+    static const char* const pieces[] =
+    {
+        "a", "Hello, world ", "0123456789abcdef0123456789abcdef", "\xc3\xa9", "\xe2\x82\xac",
+        "\xf0\x9f\x98\x80", "\xed\x9f\xbf", "\xef\xbf\xbd", "\\n", "\\\"", "\\\\"
+    };
+    static const char* const broken[] =
+    {
+        "\x80", "\xc3", "\xe2\x82", "\xf0\x9f\x98", "\xc0\x80", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xfe"
+    };
+    std::uniform_int_distribution<std::size_t> piece(0, sizeof(pieces) / sizeof(pieces[0]) - 1);
+    std::uniform_int_distribution<std::size_t> broken_piece(0, sizeof(broken) / sizeof(broken[0]) - 1);
+    std::uniform_int_distribution<std::size_t> count(0, 40);
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        std::string text;
+        for (auto n = count(rng); n > 0; --n)
+            text += pieces[piece(rng)];
+        if (i % 2)
+        {
+            auto at = text.size();
+            text += broken[broken_piece(rng)];
+            for (auto n = count(rng) / 4; n > 0; --n)
+                text += pieces[piece(rng)];
+            if (first_invalid(text, impl::e_SimdLevel::Scalar) != at)
+                fail("broken sequence", text);
+        }
+
+        check_kernels(text);
+
+        //a quote ends the scan, cutting short any sequence it lands in
+        if (!text.empty())
+        {
+            std::string quoted = text;
+            quoted.insert(std::uniform_int_distribution<std::size_t>(0, text.size() - 1)(rng), 1, '"');
+            check_kernels(quoted);
+        }
+
+        if (i % 50 == 0)
+            check_parser(text, first_invalid(text, impl::e_SimdLevel::Scalar));
+    }
+
+    std::cout << "utf8 validation, " << failures << " failed\n";
+    return failures ? 1 : 0;
+}